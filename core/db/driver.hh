@@ -0,0 +1,166 @@
+<?hh  //  strict
+
+
+/**
+ *  Database driver, the interface CoreDB expects of the connections in its pool
+ *  @name    CoreDBDriver
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    The driver is selected by the scheme of the connection URI (see CoreDB::setConnection), results are
+ *           expected to provide the CoreDBMySQLiQuery interface (next, fetchAll, rows, errno, error)
+ */
+interface CoreDBDriver {
+	/**
+	 *  Assign the connection DSN
+	 *  @name    setConnection
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string DSN URI
+	 *  @returns bool
+	 */
+	public function setConnection(string $uri):bool;
+
+	/**
+	 *  Connect to the database (if not connected already)
+	 *  @name    connect
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function connect():bool;
+
+	/**
+	 *  Disconnect from the database
+	 *  @name    disconnect
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function disconnect():bool;
+
+	/**
+	 *  Check to see whether a connection is established
+	 *  @name    isConnected
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function isConnected():bool;
+
+	/**
+	 *  Query the database
+	 *  @name    query
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @param   bool   use cache (optional, default true)
+	 *  @returns object result (null if not connected)
+	 */
+	public function query(string $query, bool $cache=true):mixed;
+
+	/**
+	 *  Prepare a query for (repeated) execution
+	 *  @name    prepare
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @returns object statement (null if not connected or not supported)
+	 */
+	public function prepare(string $query):mixed;
+
+	/**
+	 *  Execute a parameterised query
+	 *  @name    execute
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @param   array  parameters (optional, default none)
+	 *  @returns object result (null if not connected)
+	 */
+	public function execute(string $query, array $param=Array()):mixed;
+
+	/**
+	 *  Query the database, streaming the resultrows one at a time
+	 *  @name    stream
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns Generator resultrows (indexed by position)
+	 */
+	public function stream(string $query):Generator<int, mixed, void>;
+
+	/**
+	 *  Start transaction
+	 *  @name    startTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function startTransaction():bool;
+
+	/**
+	 *  End transaction by committing or rolling back
+	 *  @name    endTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @param   bool commit (optional, default true)
+	 *  @returns bool success
+	 */
+	public function endTransaction(bool $success=true):bool;
+
+	/**
+	 *  Commit a transaction
+	 *  @name    commitTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function commitTransaction():bool;
+
+	/**
+	 *  Rollback a transaction
+	 *  @name    rollbackTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function rollbackTransaction():bool;
+
+	/**
+	 *  Determine whether a transaction is going on
+	 *  @name    inTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool transaction
+	 */
+	public function inTransaction():bool;
+
+	/**
+	 *  Properly escape a string
+	 *  @name    escape
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string escaped input
+	 */
+	public function escape(string $string):string;
+
+	/**
+	 *  Quote and escape a string
+	 *  @name    quote
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string quoted escaped input
+	 */
+	public function quote(string $string):string;
+
+	/**
+	 *  get the ID of the last inserted record
+	 *  @name    lastInsertID
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int id (null if not connected)
+	 */
+	public function lastInsertID():?int;
+}
@@ -7,7 +7,7 @@
  *  @package Konsolidate
  *  @author  Rogier Spieker <rogier@konsolidate.nl>
  */
-class CoreDBMySQLi<Konsolidate> extends Konsolidate {
+class CoreDBMySQLi<Konsolidate> extends Konsolidate implements CoreDBDriver {
 	/**
 	 *  The connection URI (parsed url)
 	 *  @name    _URI
@@ -25,12 +25,68 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	protected resource $_conn;
 
 	/**
-	 *  The query cache
+	 *  The query result cache
 	 *  @name    _cache
-	 *  @type    array
+	 *  @type    CoreDBMySQLiCache
 	 *  @access  protected
 	 */
-	protected Map<string, resource> $_cache;
+	protected ?CoreDBMySQLiCache $_cache;
+
+	/**
+	 *  The prepared statement cache (least recently used first)
+	 *  @name    _statement
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, CoreDBMySQLiStatement> $_statement;
+
+	/**
+	 *  The connection pools by DSN, shared by all instances
+	 *  @name    _registry
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, CoreDBMySQLiPool> $_registry;
+
+	/**
+	 *  The result caches by namespace, shared by all instances (so a primary and its replicas share invalidation)
+	 *  @name    _caches
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, CoreDBMySQLiCache> $_caches;
+
+	/**
+	 *  The connection pool for the DSN
+	 *  @name    _pool
+	 *  @type    CoreDBMySQLiPool
+	 *  @access  protected
+	 */
+	protected ?CoreDBMySQLiPool $_pool;
+
+	/**
+	 *  The number of side connections in use for asynchronous queries
+	 *  @name    _async
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_async;
+
+	/**
+	 *  The side connections on which an asynchronous query is waiting for results
+	 *  @name    _pending
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, MySQLi> $_pending;
+
+	/**
+	 *  The side connections which have results available
+	 *  @name    _ready
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, bool> $_ready;
 
 	/**
 	 *  Wether or not a transaction is going on
@@ -40,6 +96,40 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 */
 	protected bool $_transaction;
 
+	/**
+	 *  The (nested) transaction levels, the first is the transaction itself, every other level is a savepoint. Each
+	 *  level holds its savepoint name, the tables to invalidate and the commit and rollback callbacks
+	 *  @name    _level
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<Map<string, mixed>> $_level;
+
+	/**
+	 *  The statements (query, parameters and their types) executed in the current transaction, kept to replay the
+	 *  transaction
+	 *  @name    _journal
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<Map<string, mixed>> $_journal;
+
+	/**
+	 *  The timeout of every statement in milliseconds (0 for none)
+	 *  @name    _timeout
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_timeout;
+
+	/**
+	 *  The time by which all statements of the request must be completed (shared by all connections, 0 for none)
+	 *  @name    _deadline
+	 *  @type    float
+	 *  @access  protected
+	 */
+	static protected ?float $_deadline;
+
 	/**
 	 *  The error object (Exception which isn't thrown)
 	 *  @name    error
@@ -71,9 +161,17 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 
 		$this->_URI         = null;
 		$this->_conn        = null;
-		$this->_cache       = Map<string, resource> {};
+		$this->_cache       = null;
+		$this->_statement   = Map<string, CoreDBMySQLiStatement> {};
+		$this->_pool        = null;
+		$this->_async       = 0;
+		$this->_pending     = Map<string, MySQLi> {};
+		$this->_ready       = Map<string, bool> {};
 		$this->error        = null;
 		$this->_transaction = false;
+		$this->_level       = Vector<Map<string, mixed>> {};
+		$this->_journal     = Vector<Map<string, mixed>> {};
+		$this->_timeout     = max(0, (int) $this->get('/Config/MySQLi/timeout', 0));
 
 		$this->_fingerprintreplacement = Map<string, string> {
 			'string' => $this->get('/Config/MySQLi/fingerprint_string', '"$"'),
@@ -101,6 +199,24 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 			$this->exception('Missing required username from the MySQLi DSN "' . $uri . '""');
 		}
 
+		//  results are cached per database rather than per server, a write on the primary invalidates the cached
+		//  results of its replicas as well
+		if (!static::$_caches) {
+			static::$_caches = Map<string, CoreDBMySQLiCache> {};
+		}
+		if (!static::$_caches->contains($this->cacheNamespace())) {
+			static::$_caches->set($this->cacheNamespace(), $this->instance('Cache', $this->cacheNamespace()));
+		}
+		$this->_cache = static::$_caches->get($this->cacheNamespace());
+
+		if (!static::$_registry) {
+			static::$_registry = Map<string, CoreDBMySQLiPool> {};
+		}
+		if (!static::$_registry->contains($uri)) {
+			static::$_registry->set($uri, $this->instance('Pool', $this->_URI));
+		}
+		$this->_pool = static::$_registry->get($uri);
+
 		return true;
 	}
 
@@ -114,23 +230,53 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
      *           it isn't connected
 	 */
 	public function connect():bool {
-		if (!$this->isConnected()) {
-			$this->_conn = new MySQLi(
-				$this->_URI->get('host'),
-				$this->_URI->get('user'),
-				$this->_URI->get('pass') ?: '',
-				trim($this->_URI->get('path'), '/'),
-				$this->_URI->get('port') ?: 3306
-			);
-
-			if ($this->_conn->connect_error) {
-				$this->exception($this->_conn->connect_error, $this->_conn->connect_errno);
+		$attempt = 0;
+
+		while (!$this->isConnected()) {
+			try {
+				$this->_pool->warm();
+				$this->_conn = $this->_pool->acquire();
+			}
+			catch (Exception $exception) {
+				if (!$this->register('Retry')->attempt($exception->getCode(), ++$attempt)) {
+					throw $exception;
+				}
+
+				continue;
+			}
+
+			if (!$this->_conn) {
+				$this->exception('All ' . $this->_pool->size() . ' connections in the pool are in use');
 			}
 		}
 
 		return true;
 	}
 
+	/**
+	 *  Replace the connection by a new one, discarding the current connection
+	 *  @name    reconnect
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 *  @note    Prepared statements and transactions do not survive a reconnect
+	 */
+	public function reconnect():bool {
+		foreach ($this->_statement as $statement) {
+			$statement->close();
+		}
+		$this->_statement->clear();
+
+		if ($this->isConnected()) {
+			$this->_pool->discard($this->_conn);
+			$this->_conn        = null;
+			$this->_transaction = false;
+		}
+		$this->register('Retry')->record('reconnect');
+
+		return $this->connect();
+	}
+
 	/**
 	 *  Disconnect from the database
 	 *  @name    disconnect
@@ -139,7 +285,23 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 *  @returns bool
 	 */
 	public function disconnect():bool {
-		return $this->isConnected() ? $this->_conn->close() : true;
+		//  prepared statements only exist within the connection
+		foreach ($this->_statement as $statement) {
+			$statement->close();
+		}
+		$this->_statement->clear();
+
+		//  the connection is returned to the pool, which resets the session state (rolling back the transaction)
+		if ($this->isConnected()) {
+			while (count($this->_level)) {
+				$this->_endLevel(false);
+			}
+			$this->_pool->release($this->_conn);
+			$this->_conn        = null;
+			$this->_transaction = false;
+		}
+
+		return true;
 	}
 
 	/**
@@ -168,22 +330,43 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	public function query(string $query, bool $cache=true, bool $info=false, bool $extendedInfo=false):?CoreDBMySQLiQuery {
 		$cacheKey = md5($query);
 
-		if ($cache && $this->_cache->contains($cacheKey)) {
-            $result = $this->_cache->get($cacheKey);
-			$result->rewind();
-			$result->cached = true;
+		//  within a transaction the cache is bypassed, the transaction must read its own (uncommitted) writes
+		$cache    = $cache && $this->_cache && !$this->_transaction && $this->_isCachableQuery($query);
 
-			return $result;
+		if ($cache) {
+			$cached = $this->_cache->fetch($cacheKey);
+
+			if (is_array($cached) && $this->_cache->isAvailable($cached['record'])) {
+				$result = $this->instance('Query');
+				$result->restore($query, $cached['record'], $cached['field'], $this->_cache);
+				$result->info   = 'additional query info not processed';
+				$result->cached = true;
+
+				return $result;
+			}
 		}
 
 		if ($this->connect()) {
-			$result = $this->instance('Query');
-			$result->execute($query, $this->_conn);
+			$result  = $this->instance('Query');
+			$attempt = 0;
+			$this->_execute($result, $query);
+
+			while ($result->errno > 0 && $this->_recover($result->errno, ++$attempt, $query)) {
+				$result = $this->instance('Query');
+				$this->_execute($result, $query);
+			}
+			$this->_journalise($query, null, null, $result, $attempt);
+
 			$result->info   = $info || $extendedInfo ? $this->info($extendedInfo, Array('duration' => $result->duration)) : 'additional query info not processed';
 			$result->cached = false;
 
-			if ($cache && $this->_isCachableQuery($query)) {
-				$this->_cache->set($cacheKey, $result);
+			if ($result->errno === 0) {
+				if ($cache) {
+					$this->_cache->store($cacheKey, Array('record' => $this->_cache->pack($result->materialise()), 'field' => $result->fields()), $this->_queryTables($query));
+				}
+				else {
+					$this->_invalidate($query);
+				}
 			}
 
 			return $result;
@@ -192,6 +375,331 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 		return null;
 	}
 
+	/**
+	 *  Query the database, streaming the resultrows one at a time without buffering the resultset
+	 *  @name    stream
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns Generator resultrows (indexed by position)
+	 *  @note    The connection cannot be used for other queries until all rows have been read, streamed results are
+	 *           never cached. Errors are logged (as with query), in which case no rows are produced. The timeout
+	 *           applies as with query, though only reading statements can be cancelled once they are streamed
+	 */
+	public function stream(string $query):Generator<int, mixed, void> {
+		if ($this->connect()) {
+			$result = $this->instance('Query');
+			$this->_execute($result, $query, MYSQLI_USE_RESULT);
+
+			if ($result->errno === 0) {
+				foreach ($result->stream() as $index=>$record) {
+					yield $index => $record;
+				}
+			}
+		}
+	}
+
+	/**
+	 *  Query the database asynchronously, on a side connection
+	 *  @name    genQuery
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @paran   bool   usecache (default true)
+	 *  @returns Awaitable result
+	 *  @note    Up to /Config/MySQLi/asyncconnections (default 4) pooled side connections are used, as these do not share
+	 *           the state of the main connection (e.g. transactions, session variables) only reading queries outside
+	 *           of a transaction are executed on them, others are executed synchronously on the main connection (see
+	 *           query). The same applies if mysqli_poll is not available, or no side connection can be obtained at all
+	 */
+	public async function genQuery(string $query, bool $cache=true):Awaitable<?CoreDBMySQLiQuery> {
+		if ($this->_transaction || !$this->_isReadQuery($query)) {
+			return $this->query($query, $cache);
+		}
+
+		$cacheKey = md5($query);
+		$cache    = $cache && $this->_cache && $this->_isCachableQuery($query);
+
+		if ($cache) {
+			$cached = $this->_cache->fetch($cacheKey);
+
+			if (is_array($cached) && $this->_cache->isAvailable($cached['record'])) {
+				$result = $this->instance('Query');
+				$result->restore($query, $cached['record'], $cached['field'], $this->_cache);
+				$result->info   = 'additional query info not processed';
+				$result->cached = true;
+
+				return $result;
+			}
+		}
+
+		$retry   = $this->register('Retry');
+		$attempt = 0;
+		do {
+			//  wait for a side connection to be released by one of the other pending queries, if there are none (the
+			//  pool is exhausted or cannot connect) the query is executed synchronously on the main connection instead
+			while (!($connection = $this->_acquireConnection())) {
+				if ($this->_async === 0) {
+					return $this->query($query, $cache);
+				}
+
+				await \HH\Asio\later();
+			}
+
+			$result = await $this->_genExecute($query, $connection);
+
+			//  a side connection which lost its connection is not returned to the pool, the retry obtains another one
+			$this->_releaseConnection($connection, $result->errno > 0 && $retry->isConnectionError($result->errno));
+		} while ($result->errno > 0 && $retry->attempt($result->errno, ++$attempt));
+		$this->_journalise($query, null, null, $result, $attempt);
+
+		$result->info   = 'additional query info not processed';
+		$result->cached = false;
+
+		if ($result->errno === 0 && $cache) {
+			$this->_cache->store($cacheKey, Array('record' => $this->_cache->pack($result->materialise()), 'field' => $result->fields()), $this->_queryTables($query));
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Query the database with all given queries at once, on side connections
+	 *  @name    queryAll
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable queries
+	 *  @paran   bool   usecache (default true)
+	 *  @returns Vector results (in the order of the queries)
+	 *  @note    The total duration is that of the slowest query (if there are enough side connections), rather than
+	 *           the sum of all queries
+	 */
+	public function queryAll(Traversable<string> $queries, bool $cache=true):Vector<?CoreDBMySQLiQuery> {
+		$pending = Vector<Awaitable<?CoreDBMySQLiQuery>> {};
+		foreach ($queries as $query) {
+			$pending[] = $this->genQuery($query, $cache);
+		}
+
+		return \HH\Asio\join(\HH\Asio\v($pending));
+	}
+
+	/**
+	 *  Obtain the connection pool metrics
+	 *  @name    poolMetrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function poolMetrics():Map<string, mixed> {
+		return $this->_pool ? $this->_pool->metrics() : Map<string, mixed> {};
+	}
+
+	/**
+	 *  Obtain the query result cache metrics
+	 *  @name    cacheMetrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function cacheMetrics():Map<string, mixed> {
+		return $this->_cache ? $this->_cache->metrics() : Map<string, mixed> {};
+	}
+
+	/**
+	 *  Obtain the retry metrics
+	 *  @name    retryMetrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function retryMetrics():Map<string, mixed> {
+		return $this->register('Retry')->metrics();
+	}
+
+	/**
+	 *  Query the database with all given (independent) statements in a single roundtrip
+	 *  @name    pipeline
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable queries
+	 *  @returns Vector results (one for every query, in the order of the queries)
+	 *  @note    The statements are executed in order, once a statement fails the remaining statements are not executed
+	 *           and their results carry the error of the failed statement. Results are not taken from the cache, though
+	 *           writes do invalidate the cached results. Within a transaction the executed statements are journaled,
+	 *           so a replayed transaction executes them again (one at a time)
+	 */
+	public function pipeline(Traversable<string> $queries):Vector<CoreDBMySQLiQuery> {
+		$queries = new Vector($queries);
+		$results = Vector<CoreDBMySQLiQuery> {};
+
+		if (!count($queries) || !$this->connect()) {
+			return $results;
+		}
+
+		$statement = Vector<string> {};
+		foreach ($queries as $query) {
+			$statement[] = rtrim(trim($query), ';');
+		}
+
+		$start = microtime(true);
+		if ($this->_conn->multi_query(implode(";\n", $statement))) {
+			do {
+				$result = $this->instance('Query');
+				$result->collect($queries[count($results)], $this->_conn, $start);
+				$result->info   = 'additional query info not processed';
+				$result->cached = false;
+				$results->add($result);
+
+				if ($result->errno === 0) {
+					$this->_journalise($result->query, null, null, $result, 0);
+					$this->_invalidate($result->query);
+				}
+
+				$start = microtime(true);
+			} while ($this->_conn->more_results() && $this->_conn->next_result());
+		}
+
+		//  the statement which failed to execute (if any) and the remaining statements
+		if (count($results) < count($queries)) {
+			$errno = $this->_conn->errno;
+			$error = $this->_conn->error;
+
+			$this->call('/Log/write', get_class($this) . '::pipeline failed: (' . $errno . ') ' . $error . PHP_EOL . '--> ' . $queries[count($results)], 2);
+
+			$result = $this->instance('Query');
+			$result->skip($queries[count($results)], $error, $errno);
+			$result->cached = false;
+			$results->add($result);
+
+			while (count($results) < count($queries)) {
+				$result = $this->instance('Query');
+				$result->skip($queries[count($results)], 'Not executed, a previous statement failed: ' . $error, $errno);
+				$result->cached = false;
+				$results->add($result);
+			}
+		}
+
+		return $results;
+	}
+
+	/**
+	 *  Prepare a query, reusing the statement if it was prepared before on this connection
+	 *  @name    prepare
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @returns object statement (null if the server refused to prepare the query, the connection holds the error)
+	 *  @note    The number of statements kept per connection is limited by /Config/MySQLi/statementcache (default 32),
+	 *           the least recently used statement is closed when the limit is exceeded
+	 */
+	public function prepare(string $query):?CoreDBMySQLiStatement {
+		$key = $this->_statementKey($query);
+
+		if ($this->_statement->contains($key)) {
+			//  move the statement to the end, marking it as most recently used
+			$statement = $this->_statement->get($key);
+			$this->_statement->remove($key);
+			$this->_statement->set($key, $statement);
+
+			return $statement;
+		}
+
+		if ($this->connect()) {
+			$statement = $this->instance('Statement');
+			if (!$statement->prepare($query, $this->_conn)) {
+				return null;
+			}
+
+			$this->_statement->set($key, $statement);
+			while (count($this->_statement) > max(1, (int) $this->get('/Config/MySQLi/statementcache', 32))) {
+				$this->_statement->get($this->_statement->firstKey())->close();
+				$this->_statement->remove($this->_statement->firstKey());
+			}
+
+			return $statement;
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Execute a parameterised query
+	 *  @name    execute
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @param   array  parameters (optional, default none)
+	 *  @param   string types (optional, default determined by the parameter types, 'i', 'd' or 's' per parameter)
+	 *  @paran   bool   add info (default false)
+	 *  @paran   bool   extended info (default true)
+	 *  @returns object result
+	 *  @note    Unlike query, the results are never cached as the parameters are not part of the query. As with query,
+	 *           errors (including a query the server refuses to prepare) are reported by the result
+	 */
+	public function execute(string $query, array $param=Array(), ?string $types=null, bool $info=false, bool $extendedInfo=false):?CoreDBMySQLiQuery {
+		$result  = $this->instance('Query');
+		$attempt = 0;
+
+		//  prepared statements are not given a MAX_EXECUTION_TIME hint, as the hint would be part of the statement
+		if ($this->_getTimeout() === 0) {
+			$result->skip($query, 'The request time budget is exhausted', 3024);
+
+			return $result;
+		}
+		$this->_executeStatement($result, $query, $param, $types);
+
+		//  a reconnect closes the prepared statements, so the statement is prepared again
+		while ($result->errno > 0 && $this->_recover($result->errno, ++$attempt, $query)) {
+			$result = $this->instance('Query');
+			$this->_executeStatement($result, $query, $param, $types);
+		}
+		$this->_journalise($query, $param, $types, $result, $attempt);
+
+		$result->info   = $info || $extendedInfo ? $this->info($extendedInfo, Array('duration' => $result->duration)) : 'additional query info not processed';
+		$result->cached = false;
+
+		if ($result->errno === 0) {
+			$this->_invalidate($query);
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Create a batch writer for the given table
+	 *  @name    batch
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string      table
+	 *  @param   Traversable columns
+	 *  @param   Traversable columns to update for existing rows (optional, default none)
+	 *  @param   bool        use LOAD DATA LOCAL INFILE (optional, default false, multi-row INSERT statements)
+	 *  @returns object batch
+	 *  @note    LOAD DATA LOCAL INFILE must be enabled on both the server (local_infile) and the client
+	 *           (/Config/MySQLi/localinfile), it cannot be combined with updating existing rows
+	 */
+	public function batch(string $table, Traversable<string> $column, ?Traversable<string> $update=null, bool $load=false):CoreDBMySQLiBatch {
+		$this->import('batch.hh');
+
+		return $this->instance('Batch', $table, $column, $update, $load ? CoreDBMySQLiBatch::MODE_LOAD : CoreDBMySQLiBatch::MODE_INSERT);
+	}
+
+	/**
+	 *  Create a row cache for primary key lookups of the given table
+	 *  @name    row
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string table
+	 *  @param   string primary key column (optional, default 'id')
+	 *  @returns object row cache
+	 *  @note    Rows of all tables of the database share a single cache (see CoreDBMySQLiRow)
+	 */
+	public function row(string $table, string $key='id'):CoreDBMySQLiRow {
+		$this->import('row.hh');
+
+		return $this->instance('Row', $table, $key);
+	}
+
 	/**
 	 *  create a fingerprint for given query, attempting to remove all variable components
 	 *  @name    fingerprint
@@ -200,30 +708,14 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 *  @param   string   query
 	 *  @param   bool     hash output (default true)
 	 *  @param   bool     strip escaped names (default false)
+	 *  @param   Map      replacements (default the configured replacements)
 	 *  @returns string   fingerprint
+	 *  @note    literal values are replaced, lists of values are reduced to a single value, comments are removed,
+	 *           whitespace is normalised and keywords are uppercased (see CoreDBMySQLiTokenizer::normalise)
 	 */
 	public function fingerprint(string $query, bool $hash=true, bool $stripName=false, Map<string, string> $replace=Map {}):string {
-		$replace = array_merge($this->_fingerprintreplacement, $replace);
-		$string  = $replace->get('string');
-		$number  = $replace->get('number');
-		$null    = $replace->get('NULL');
-		$names   = $replace->get('names');
-		$replace = Array(
-			'/([\"\'])(?:.*[^\\\\]+)*(?:(?:\\\\{2})*)+\1/xU' => $string, //  replace quoted variables
-			"/--.*?[\r\n]+/"=>"",                                        //  strip '--' comments
-			"/#.*?[\r\n]+/"=>"",                                         //  strip '#' comments
-			"/\/\*.*?\*\//"=>"",                                         //  strip /* */ comments
-			"/\s*([\(\)=\+\/,-]+)/"=>"\\1",                              //  strip whitespace left of specific chars
-			"/([\(=\+\/,-]+)\s*/"=>"\\1",                                //  strip whitespace right of specific chars
-			"/\b[0-9]*[\.]*[0-9]+\b/" => $number,                        //  replace numbers which appear to be values
-			"/\bNULL\b/i" => $null,                                      //  replace NULL values
-			"/\s+/"=>" "                                                 //  replace (multiple) whitespace chars by space
-		);
-
-		if ( $stripName ) {
-			$replace->set('/`.*?`/', $names);
-		}
-		$result = trim(preg_replace($replace->keys(), $replace->values(), $query));
+		$replacement = new Map($this->_fingerprintreplacement);
+		$result      = $this->call('Tokenizer/normalise', $query, true, $stripName, $replacement->setAll($replace));
 
 		return $hash ? md5($result) : $result;
 	}
@@ -236,7 +728,7 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 *  @returns int id
 	 */
 	public function lastInsertID():?int {
-        return $this->isConnected() ? mysqli_insert_id($this->_conn) : null;
+        return $this->isConnected() ? $this->_conn->insert_id : null;
 	}
 
 	/**
@@ -262,7 +754,7 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 */
 	public function escape(string $string):string {
 		if ($this->connect()) {
-			return mysqli_real_escape_string($this->_conn, $string);
+			return $this->_conn->real_escape_string($string);
 		}
 
 		$this->call('/Log/write', get_class($this) . '::escape, could not escape string');
@@ -283,18 +775,37 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	}
 
 	/**
-	 *  Start transaction
+	 *  Start transaction, or a nested transaction (savepoint) if a transaction is going on already
 	 *  @name    startTransaction
 	 *  @type    method
 	 *  @access  public
 	 *  @returns bool success
+	 *  @note    Every startTransaction must be matched by an endTransaction, ending a nested transaction releases or
+	 *           rolls back to its savepoint, only the outermost transaction is actually committed
 	 */
 	public function startTransaction():bool {
-		if ($this->connect() && !$this->_transaction) {
-			$this->_transaction = $this->_conn->autocommit(false);
+		if (!$this->connect()) {
+			return false;
 		}
 
-		return $this->_transaction;
+		if (!$this->_transaction) {
+			if ($this->_begin()) {
+				$this->_level->add($this->_createLevel(null));
+			}
+
+			return $this->_transaction;
+		}
+
+		$savepoint = 'konsolidate_' . count($this->_level);
+		$result    = $this->query('SAVEPOINT `' . $savepoint . '`', false);
+
+		if ($result && $result->errno === 0) {
+			$this->_level->add($this->_createLevel($savepoint));
+
+			return true;
+		}
+
+		return false;
 	}
 
 	/**
@@ -307,8 +818,33 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 *  @note    if argument 'commit' is true, 'COMMIT' is sent, 'ROLLBACK' otherwise
 	 */
 	public function endTransaction($success=true):bool {
+		if (count($this->_level) > 1) {
+			$savepoint = '`' . $this->_level->lastValue()->get('savepoint') . '`';
+
+			//  rolling back to a savepoint keeps the savepoint, so it is released either way
+			$result = $success ? null : $this->query('ROLLBACK TO SAVEPOINT ' . $savepoint, false);
+			if (!$result || $result->errno === 0) {
+				$result = $this->query('RELEASE SAVEPOINT ' . $savepoint, false);
+			}
+
+			if ($result && $result->errno === 0) {
+				$this->_endLevel((bool) $success);
+
+				return true;
+			}
+
+			return false;
+		}
+
 		if ($this->_transaction) {
 			$this->_transaction = !($success ? $this->_conn->commit() : $this->_conn->rollback());
+
+			if (!$this->_transaction) {
+				//  leave the connection in autocommit mode, later statements must not join an untracked transaction
+				$this->_conn->autocommit(true);
+				$this->_journal->clear();
+				$this->_endLevel((bool) $success);
+			}
 		}
 
 		return !$this->_transaction;
@@ -340,14 +876,187 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 
 
 	/**
-	 *  Returns the default character set for the database connection
-	 *  @name    characterSetName
+	 *  Register a callback to be called once the transaction is committed (immediately if there is no transaction)
+	 *  @name    onCommit
 	 *  @type    method
 	 *  @access  public
-	 *  @returns string characterset
+	 *  @param   callable callback
+	 *  @param   array    arguments (optional, default none)
+	 *  @returns void
+	 *  @note    Callbacks registered in a nested transaction are dropped if it is rolled back, and called only once the
+	 *           outermost transaction is committed
 	 */
-	public function characterSetName():string {
-		return $this->_conn->character_set_name();
+	public function onCommit(callable $callback, array $param=Array()):void {
+		if (count($this->_level)) {
+			$this->_level->lastValue()->get('commit')->add(Pair {$callback, $param});
+		}
+		else {
+			$this->_callback(Vector<Pair<callable, array>> {Pair {$callback, $param}});
+		}
+	}
+
+	/**
+	 *  Register a callback to be called if the (nested) transaction is rolled back
+	 *  @name    onRollback
+	 *  @type    method
+	 *  @access  public
+	 *  @param   callable callback
+	 *  @param   array    arguments (optional, default none)
+	 *  @returns void
+	 *  @note    Without a transaction the callback is ignored, as there is nothing to roll back
+	 */
+	public function onRollback(callable $callback, array $param=Array()):void {
+		if (count($this->_level)) {
+			$this->_level->lastValue()->get('rollback')->add(Pair {$callback, $param});
+		}
+	}
+
+	/**
+	 *  Obtain the nesting level of the transaction
+	 *  @name    transactionLevel
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int level (0 if there is no transaction)
+	 */
+	public function transactionLevel():int {
+		return count($this->_level);
+	}
+
+	/**
+	 *  Set the timeout of every statement
+	 *  @name    setTimeout
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    milliseconds (0 for none)
+	 *  @returns void
+	 *  @note    The default is /Config/MySQLi/timeout, SELECT statements are given a MAX_EXECUTION_TIME hint, other
+	 *           statements are cancelled using KILL QUERY once the timeout expires. Statements which time out fail with
+	 *           a CoreDBMySQLiExceptionTimeout as exception
+	 */
+	public function setTimeout(int $milliseconds):void {
+		$this->_timeout = max(0, $milliseconds);
+	}
+
+	/**
+	 *  Set the time by which all statements of the request must be completed
+	 *  @name    setDeadline
+	 *  @type    method
+	 *  @access  public
+	 *  @param   float  deadline (unix timestamp, 0 for none)
+	 *  @returns void
+	 *  @note    The default deadline is /Config/MySQLi/budget milliseconds after the start of the request, a caller
+	 *           which has a deadline of its own (e.g. propagated by an upstream service) should pass it on. The
+	 *           deadline applies to all connections, statements are never given more time than remains
+	 */
+	public function setDeadline(float $deadline):void {
+		static::$_deadline = max(0.0, $deadline);
+	}
+
+	/**
+	 *  Obtain the time by which all statements of the request must be completed
+	 *  @name    deadline
+	 *  @type    method
+	 *  @access  public
+	 *  @returns float  deadline (null if there is none)
+	 */
+	public function deadline():?float {
+		if (is_null(static::$_deadline)) {
+			$budget = (int) $this->get('/Config/MySQLi/budget', 0);
+			$start  = isset($_SERVER['REQUEST_TIME_FLOAT']) ? (float) $_SERVER['REQUEST_TIME_FLOAT'] : microtime(true);
+
+			static::$_deadline = $budget > 0 ? $start + $budget / 1000 : 0.0;
+		}
+
+		return static::$_deadline > 0 ? static::$_deadline : null;
+	}
+
+	/**
+	 *  Obtain the server (host and port) of the connection DSN
+	 *  @name    server
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string server
+	 */
+	public function server():string {
+		return sprintf('%s:%s', $this->_URI->get('host'), $this->_URI->get('port') ?: 3306);
+	}
+
+	/**
+	 *  Obtain the database of the connection DSN
+	 *  @name    database
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string database
+	 */
+	public function database():string {
+		return trim($this->_URI->get('path'), '/');
+	}
+
+	/**
+	 *  Obtain the namespace of the cached results, shared by the primary and replicas of a database
+	 *  @name    cacheNamespace
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string namespace
+	 *  @note    The namespace is the database, unless the DSN provides one (e.g. ?cache=cluster1/shop), which is
+	 *           required if unrelated servers host databases by the same name. Fake databases (see CoreDBMySQLiFake)
+	 *           never share the namespace of a real database
+	 */
+	public function cacheNamespace():string {
+		$option = Array();
+		parse_str($this->_URI->get('query') ?: '', $option);
+
+		if (isset($option['cache']) && $option['cache'] !== '') {
+			return (string) $option['cache'];
+		}
+
+		return (array_key_exists('fake', $option) ? 'fake:' : '') . $this->database();
+	}
+
+	/**
+	 *  Obtain the fake server of the connection, to script its responses and inspect the queries it received
+	 *  @name    fake
+	 *  @type    method
+	 *  @access  public
+	 *  @returns CoreDBMySQLiFake fake server (null if the DSN has no fake option)
+	 */
+	public function fake():?CoreDBMySQLiFake {
+		return $this->_pool ? $this->_pool->fake() : null;
+	}
+
+	/**
+	 *  Determine whether a transaction is going on
+	 *  @name    inTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool transaction
+	 */
+	public function inTransaction():bool {
+		return $this->_transaction;
+	}
+
+	/**
+	 *  Obtain the number of seconds the database (as replica) is behind its primary
+	 *  @name    replicationLag
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int seconds (null if the database is not replicating)
+	 */
+	public function replicationLag():?int {
+		$lag = $this->instance('Info')->get('Replication/seconds_behind_master');
+
+		return is_numeric($lag) ? (int) $lag : null;
+	}
+
+	/**
+	 *  Returns the default character set for the database connection
+	 *  @name    characterSetName
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string characterset
+	 */
+	public function characterSetName():string {
+		return $this->_conn->character_set_name();
 	}
 
 	/**
@@ -443,6 +1152,500 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 		return sprintf('%d.%d.%d', $major, $minor, ($version - (($major * 10000) + ($minor * 100))));
 	}
 
+	/**
+	 *  Create the key for the prepared statement cache
+	 *  @name    _statementKey
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns string key
+	 *  @note    the literal values are part of the statement, so only comments, whitespace and keywords are normalised
+	 */
+	protected function _statementKey(string $query):string {
+		return md5($this->call('Tokenizer/normalise', $query, false));
+	}
+
+	/**
+	 *  Obtain a side connection from the pool, as long as the limit for asynchronous queries has not been reached
+	 *  @name    _acquireConnection
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns MySQLi connection (null if no side connection is available)
+	 */
+	protected function _acquireConnection():?MySQLi {
+		if ($this->_async < max(1, (int) $this->get('/Config/MySQLi/asyncconnections', 4))) {
+			$connection = $this->_pool->acquire();
+
+			if ($connection) {
+				++$this->_async;
+
+				return $connection;
+			}
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Return a side connection to the pool
+	 *  @name    _releaseConnection
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   MySQLi connection
+	 *  @param   bool   discard the connection instead (optional, default false)
+	 *  @returns void
+	 */
+	protected function _releaseConnection(MySQLi $connection, bool $discard=false):void {
+		--$this->_async;
+
+		if ($discard) {
+			$this->_pool->discard($connection);
+		}
+		else {
+			$this->_pool->release($connection);
+		}
+	}
+
+	/**
+	 *  Poll all side connections waiting for results at once, marking those which are ready
+	 *  @name    _poll
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns void
+	 *  @note    Blocks for at most /Config/MySQLi/asyncpoll microseconds (default 10000) if none are ready
+	 */
+	protected function _poll():void {
+		if (!count($this->_pending)) {
+			return;
+		}
+
+		$read   = $this->_pending->values()->toArray();
+		$error  = $this->_pending->values()->toArray();
+		$reject = $this->_pending->values()->toArray();
+
+		if (mysqli_poll($read, $error, $reject, 0, (int) $this->get('/Config/MySQLi/asyncpoll', 10000)) !== false) {
+			//  connections with errors are reaped as well, reap_async_query will report the error
+			foreach (array_merge($read, $error, $reject) as $connection) {
+				$key = spl_object_hash($connection);
+				$this->_pending->remove($key);
+				$this->_ready->set($key, true);
+			}
+		}
+	}
+
+	/**
+	 *  Execute given query, applying the timeout
+	 *  @name    _execute
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   object result
+	 *  @param   string query
+	 *  @param   int    result mode (optional, default MYSQLI_STORE_RESULT)
+	 *  @returns void
+	 *  @note    Unbuffered (MYSQLI_USE_RESULT) statements cannot be sent asynchronously, so only the reading
+	 *           statements (by the MAX_EXECUTION_TIME hint) are cancelled
+	 */
+	protected function _execute(CoreDBMySQLiQuery $result, string $query, int $mode=MYSQLI_STORE_RESULT):void {
+		$timeout = $this->_getTimeout();
+
+		if (is_null($timeout)) {
+			$result->execute($query, $this->_conn, $mode);
+		}
+		else if ($timeout === 0) {
+			$result->skip($query, 'The request time budget is exhausted', 3024);
+		}
+		//  the server aborts reading statements itself (MySQL 5.7.8+), other versions ignore the hint
+		else if (preg_match('/^\s*SELECT\b/i', $query) && stripos($query, 'MAX_EXECUTION_TIME') === false) {
+			$result->execute(preg_replace('/^\s*SELECT\b/i', 'SELECT /*+ MAX_EXECUTION_TIME(' . $timeout . ') */', $query, 1), $this->_conn, $mode);
+		}
+		else if ($mode === MYSQLI_STORE_RESULT && function_exists('mysqli_poll') && $result->send($query, $this->_conn)) {
+			$this->_watch($result, $timeout);
+		}
+		else {
+			$result->execute($query, $this->_conn, $mode);
+		}
+	}
+
+	/**
+	 *  Execute given (reading) query on a side connection, applying the timeout
+	 *  @name    _genExecute
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @param   MySQLi side connection
+	 *  @returns Awaitable result
+	 *  @note    Only reading queries are executed on side connections, so the timeout is applied by the
+	 *           MAX_EXECUTION_TIME hint alone
+	 */
+	protected async function _genExecute(string $query, MySQLi $connection):Awaitable<CoreDBMySQLiQuery> {
+		$result  = $this->instance('Query');
+		$timeout = $this->_getTimeout();
+
+		if ($timeout === 0) {
+			$result->skip($query, 'The request time budget is exhausted', 3024);
+
+			return $result;
+		}
+		else if (!is_null($timeout) && stripos($query, 'MAX_EXECUTION_TIME') === false) {
+			$query = preg_replace('/^\s*SELECT\b/i', 'SELECT /*+ MAX_EXECUTION_TIME(' . $timeout . ') */', $query, 1);
+		}
+
+		if (function_exists('mysqli_poll') && $result->send($query, $connection)) {
+			$key = spl_object_hash($connection);
+			$this->_pending->set($key, $connection);
+
+			while (!$this->_ready->contains($key)) {
+				$this->_poll();
+
+				if (!$this->_ready->contains($key)) {
+					await \HH\Asio\later();
+				}
+			}
+
+			$this->_ready->remove($key);
+			$result->reap();
+		}
+		else {
+			$result->execute($query, $connection);
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Execute given parameterised query, preparing the statement if needed
+	 *  @name    _executeStatement
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   object result
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @param   array  parameters
+	 *  @param   string types (null to determine them by the parameter types)
+	 *  @returns void
+	 *  @note    If the statement cannot be prepared, the result carries the error of the connection
+	 */
+	protected function _executeStatement(CoreDBMySQLiQuery $result, string $query, array $param, ?string $types):void {
+		$statement = $this->prepare($query);
+
+		if ($statement) {
+			$result->executeStatement($statement, $param, $types);
+		}
+		else {
+			$result->skip($query, $this->_conn->error, $this->_conn->errno);
+		}
+	}
+
+	/**
+	 *  Wait for the result of a sent query, cancelling the query using KILL QUERY once the timeout expires
+	 *  @name    _watch
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   object result
+	 *  @param   int    timeout in milliseconds
+	 *  @returns void
+	 */
+	protected function _watch(CoreDBMySQLiQuery $result, int $timeout):void {
+		$deadline = microtime(true) + $timeout / 1000;
+		$ready    = 0;
+
+		while ($ready === 0 && ($wait = $deadline - microtime(true)) > 0) {
+			$read   = Array($this->_conn);
+			$error  = Array($this->_conn);
+			$reject = Array($this->_conn);
+			$ready  = mysqli_poll($read, $error, $reject, (int) $wait, (int) (($wait - floor($wait)) * 1000000));
+		}
+
+		if ($ready === 0) {
+			$result->expire();
+			$this->_kill($this->_conn->thread_id);
+		}
+
+		//  a cancelled query is reported as interrupted (1317) by the server
+		$result->reap();
+	}
+
+	/**
+	 *  Cancel the statement running on the given connection, using a side connection
+	 *  @name    _kill
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   int    thread id of the connection
+	 *  @returns bool   success
+	 */
+	protected function _kill(int $thread):bool {
+		$connection = $this->_pool->acquire();
+
+		if (!$connection) {
+			$this->call('/Log/write', get_class($this) . '::_kill no connection available to cancel thread ' . $thread, 2);
+
+			return false;
+		}
+
+		$success = (bool) $connection->query('KILL QUERY ' . $thread);
+		$this->_pool->release($connection);
+
+		return $success;
+	}
+
+	/**
+	 *  Determine the time a statement may take
+	 *  @name    _getTimeout
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns int    milliseconds (null for no limit, 0 if the request time budget is exhausted)
+	 */
+	protected function _getTimeout():?int {
+		$timeout  = $this->_timeout > 0 ? $this->_timeout : null;
+		$deadline = $this->deadline();
+
+		if (!is_null($deadline)) {
+			$remaining = max(0, (int) floor(($deadline - microtime(true)) * 1000));
+			$timeout   = is_null($timeout) ? $remaining : min($timeout, $remaining);
+		}
+
+		return $timeout;
+	}
+
+	/**
+	 *  Recover from the given error if the retry policy allows it, reconnecting and replaying the transaction if needed
+	 *  @name    _recover
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   int    error number
+	 *  @param   int    attempt (1 for the first retry)
+	 *  @param   string query
+	 *  @returns bool   the query can be retried
+	 */
+	protected function _recover(int $errno, int $attempt, string $query):bool {
+		$retry       = $this->register('Retry');
+		$transaction = $this->_transaction;
+
+		if (!$retry->attempt($errno, $attempt, $this->_isModifyingQuery($query), $transaction)) {
+			return false;
+		}
+
+		if ($retry->isConnectionError($errno)) {
+			$this->reconnect();
+		}
+
+		return !$transaction || !$retry->isTransactionLost($errno) || $this->_replay();
+	}
+
+	/**
+	 *  Start a new transaction, executing all statements of the rolled back transaction again
+	 *  @name    _replay
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns bool   success
+	 */
+	protected function _replay():bool {
+		$journal            = new Vector($this->_journal);
+		$this->_transaction = false;
+
+		//  the transaction levels remain, the savepoints are part of the journal
+		if (!$this->_begin()) {
+			return false;
+		}
+		$this->register('Retry')->record('replay');
+
+		foreach ($journal as $entry) {
+			$query  = (string) $entry->get('query');
+			$param  = $entry->get('param');
+			$result = $this->instance('Query');
+
+			if (is_null($param)) {
+				$result->execute($query, $this->_conn);
+			}
+			else {
+				$this->_executeStatement($result, $query, $param, $entry->get('types'));
+			}
+
+			if ($result->errno > 0) {
+				return false;
+			}
+			$this->_journal->add($entry);
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Keep track of a successful statement, for the retry metrics and to replay the transaction
+	 *  @name    _journalise
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @param   array  parameters (null for queries which are not prepared)
+	 *  @param   string parameter types (null to determine them by the parameter types)
+	 *  @param   object result
+	 *  @param   int    number of retries
+	 *  @returns void
+	 */
+	protected function _journalise(string $query, ?array $param, ?string $types, CoreDBMySQLiQuery $result, int $attempt):void {
+		if ($result->errno > 0) {
+			return;
+		}
+
+		if ($attempt > 0) {
+			$this->register('Retry')->record('recovered');
+		}
+
+		if ($this->_transaction && $this->register('Retry')->replay()) {
+			$this->_journal->add(Map<string, mixed> {
+				'query' => $query,
+				'param' => $param,
+				'types' => $types
+			});
+		}
+	}
+
+	/**
+	 *  Invalidate the cached results of the tables modified by given query
+	 *  @name    _invalidate
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns void
+	 */
+	protected function _invalidate(string $query):void {
+		if ($this->_cache && $this->_isModifyingQuery($query)) {
+			$tables = $this->_queryTables($query);
+
+			//  if the tables cannot be determined, all cached results of the namespace are invalidated
+			if (!count($tables)) {
+				$tables = Vector<string> {CoreDBMySQLiCache::TAG_ALL};
+			}
+
+			//  within a transaction the invalidation is deferred until (and unless) the transaction is committed
+			if (count($this->_level)) {
+				$this->_level->lastValue()->get('tables')->addAll($tables);
+			}
+			else {
+				$this->_cache->invalidate($tables);
+			}
+		}
+	}
+
+	/**
+	 *  Begin the (outermost) transaction on the connection
+	 *  @name    _begin
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns bool   success
+	 */
+	protected function _begin():bool {
+		$this->_transaction = $this->_conn->autocommit(false);
+		$this->_journal->clear();
+
+		return $this->_transaction;
+	}
+
+	/**
+	 *  Create a transaction level
+	 *  @name    _createLevel
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string savepoint (null for the transaction itself)
+	 *  @returns Map    level
+	 */
+	protected function _createLevel(?string $savepoint):Map<string, mixed> {
+		return Map<string, mixed> {
+			'savepoint' => $savepoint,
+			'tables'    => Set<string> {},
+			'commit'    => Vector<Pair<callable, array>> {},
+			'rollback'  => Vector<Pair<callable, array>> {}
+		};
+	}
+
+	/**
+	 *  End the innermost transaction level
+	 *  @name    _endLevel
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   bool   committed
+	 *  @returns void
+	 *  @note    A committed savepoint hands its invalidations and callbacks to the enclosing level, as its changes are
+	 *           only final once the transaction is committed
+	 */
+	protected function _endLevel(bool $committed):void {
+		$level = $this->_level->pop();
+
+		if (!$committed) {
+			$this->_callback($level->get('rollback'));
+		}
+		else if (count($this->_level)) {
+			$parent = $this->_level->lastValue();
+			$parent->get('tables')->addAll($level->get('tables'));
+			$parent->get('commit')->addAll($level->get('commit'));
+			$parent->get('rollback')->addAll($level->get('rollback'));
+		}
+		else {
+			if ($this->_cache && count($level->get('tables'))) {
+				$this->_cache->invalidate($level->get('tables'));
+			}
+			$this->_callback($level->get('commit'));
+		}
+	}
+
+	/**
+	 *  Call the given transaction callbacks
+	 *  @name    _callback
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Vector callbacks (and their arguments)
+	 *  @returns void
+	 *  @note    The transaction has ended already, so exceptions are logged instead of thrown
+	 */
+	protected function _callback(Vector<Pair<callable, array>> $callbacks):void {
+		foreach ($callbacks as $callback) {
+			list($callable, $param) = $callback;
+
+			try {
+				call_user_func_array($callable, $param);
+			}
+			catch (Exception $exception) {
+				$this->call('/Log/write', get_class($this) . ' transaction callback failed: ' . $exception->getMessage(), 2);
+			}
+		}
+	}
+
+	/**
+	 *  Extract the (lowercase, unqualified) names of the tables involved in given query
+	 *  @name    _queryTables
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns Vector tables
+	 */
+	protected function _queryTables(string $query):Vector<string> {
+		return $this->call('Tokenizer/tables', $query);
+	}
+
+	/**
+	 *  Determine whether a query modifies data or structure (and therefor should invalidate the cached results)
+	 *  @name    _isModifyingQuery
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns bool   modifying
+	 */
+	protected function _isModifyingQuery(string $query):bool {
+		return (bool) preg_match('/^\s*(?:INSERT|UPDATE|DELETE|REPLACE|TRUNCATE|ALTER|DROP|CREATE|RENAME|LOAD)\b/i', $query);
+	}
+
+	/**
+	 *  Determine whether a query only reads data (see CoreDB::_isReadQuery)
+	 *  @name    _isReadQuery
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns bool   reading
+	 *  @note    locking reads (FOR UPDATE, LOCK IN SHARE MODE) are not considered to be reading queries
+	 */
+	protected function _isReadQuery(string $query):bool {
+		return (bool) preg_match('/^\s*SELECT /i', $query) && !preg_match('/\b(?:FOR\s+UPDATE|LOCK\s+IN\s+SHARE\s+MODE)\b/i', $query);
+	}
+
 	/**
 	 *  Determine whether a query should be cached (this applies only to 'SELECT' queries)
 	 *  @name    _isCachableQuery
@@ -450,8 +1653,10 @@ class CoreDBMySQLi<Konsolidate> extends Konsolidate {
 	 *  @access  protected
 	 *  @param   string query
 	 *  @returns bool   success
+	 *  @note    As cached results may be shared with other connections, locking reads, queries without tables and
+	 *           queries depending on the session or time (e.g. LAST_INSERT_ID(), NOW(), @variables) are not cached
 	 */
 	protected function _isCachableQuery($query):bool {
-		return (bool) preg_match('/^\s*SELECT /i', $query);
+		return $this->_isReadQuery($query) && count($this->_queryTables($query)) > 0 && $this->call('Tokenizer/isDeterministic', $query);
 	}
 }
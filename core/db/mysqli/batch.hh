@@ -0,0 +1,371 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQLi batch writer, buffering rows and writing them using multi-row INSERT statements or LOAD DATA LOCAL INFILE
+ *  @name    CoreDBMySQLiBatch
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Batches are created by CoreDBMySQLi::batch, rows are written automatically when the statement would exceed
+ *           max_allowed_packet or the buffer holds /Config/MySQLi/batchrows rows (default 1000), remaining rows are
+ *           written by flush
+ */
+class CoreDBMySQLiBatch<Konsolidate> extends Konsolidate {
+	const MODE_INSERT = 'insert';
+	const MODE_LOAD   = 'load';
+
+	/**
+	 *  The table
+	 *  @name    _table
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_table;
+
+	/**
+	 *  The columns
+	 *  @name    _column
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<string> $_column;
+
+	/**
+	 *  The columns to update if a row already exists (ON DUPLICATE KEY UPDATE)
+	 *  @name    _update
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<string> $_update;
+
+	/**
+	 *  The write mode (MODE_INSERT or MODE_LOAD)
+	 *  @name    _mode
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_mode;
+
+	/**
+	 *  The buffered rows (formatted for the write mode)
+	 *  @name    _buffer
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<string> $_buffer;
+
+	/**
+	 *  The size of the buffered rows in bytes
+	 *  @name    _size
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_size;
+
+	/**
+	 *  The maximum size of a single statement in bytes (determined on first use)
+	 *  @name    _limit
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_limit;
+
+	/**
+	 *  The statistics of every written batch
+	 *  @name    _statistic
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<Map<string, mixed>> $_statistic;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object      parent object
+	 *  @param   string      table
+	 *  @param   Traversable columns
+	 *  @param   Traversable columns to update for existing rows (optional, default none)
+	 *  @param   string      mode (optional, default MODE_INSERT)
+	 *  @returns object
+	 *  @throws  Exception if rows are to be updated using MODE_LOAD
+	 */
+	public function __construct(Konsolidate $parent, string $table, Traversable<string> $column, ?Traversable<string> $update=null, string $mode=self::MODE_INSERT) {
+		parent::__construct($parent);
+
+		$this->_table     = $table;
+		$this->_column    = new Vector($column);
+		$this->_update    = $update ? new Vector($update) : Vector<string> {};
+		$this->_mode      = $mode;
+		$this->_buffer    = Vector<string> {};
+		$this->_size      = 0;
+		$this->_limit     = 0;
+		$this->_statistic = Vector<Map<string, mixed>> {};
+
+		if ($this->_mode === self::MODE_LOAD && count($this->_update)) {
+			$this->exception('LOAD DATA cannot update existing rows (ON DUPLICATE KEY UPDATE), use MODE_INSERT instead');
+		}
+	}
+
+	/**
+	 *  Add a row to the batch
+	 *  @name    add
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  values (in column order, or keyed by column name)
+	 *  @returns int    number of buffered rows
+	 */
+	public function add(mixed $row):int {
+		$row   = (array) $row;
+		$value = Array();
+		foreach ($this->_column as $index=>$column) {
+			$value[] = array_key_exists($column, $row) ? $row[$column] : (array_key_exists($index, $row) ? $row[$index] : null);
+		}
+
+		$formatted = $this->_mode === self::MODE_LOAD ? $this->_formatLine($value) : $this->_formatTuple($value);
+		$size      = strlen($formatted) + 1;
+
+		if (count($this->_buffer) && ($this->_size + $size > $this->_getLimit() || count($this->_buffer) >= $this->_getRowLimit())) {
+			$this->flush();
+		}
+
+		$this->_buffer->add($formatted);
+		$this->_size += $size;
+
+		return count($this->_buffer);
+	}
+
+	/**
+	 *  Write all buffered rows
+	 *  @name    flush
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map    statistics of the batch (null if there was nothing to write)
+	 */
+	public function flush():?Map<string, mixed> {
+		if (!count($this->_buffer)) {
+			return null;
+		}
+
+		$file   = null;
+		$result = null;
+		if ($this->_mode === self::MODE_LOAD) {
+			$file = tempnam(sys_get_temp_dir(), 'batch');
+			file_put_contents($file, implode("\n", $this->_buffer) . "\n");
+			$result = $this->call('../query', $this->_createLoadStatement($file), false);
+			unlink($file);
+		}
+		else {
+			$result = $this->call('../query', $this->_createInsertStatement(), false);
+		}
+
+		$statistic = Map<string, mixed> {
+			'rows'     => count($this->_buffer),
+			'bytes'    => $this->_size,
+			'affected' => is_object($result) ? $result->rows : 0,
+			'duration' => is_object($result) ? $result->duration : 0,
+			'errno'    => is_object($result) ? $result->errno : -1,
+			'error'    => is_object($result) ? $result->error : 'not connected'
+		};
+		$this->_statistic->add($statistic);
+
+		$this->_buffer->clear();
+		$this->_size = 0;
+
+		return $statistic;
+	}
+
+	/**
+	 *  Obtain the statistics of every written batch
+	 *  @name    statistics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Vector statistics
+	 */
+	public function statistics():Vector<Map<string, mixed>> {
+		return $this->_statistic;
+	}
+
+	/**
+	 *  Create the multi-row INSERT statement for the buffered rows
+	 *  @name    _createInsertStatement
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns string query
+	 */
+	protected function _createInsertStatement():string {
+		return $this->_createPrefix() . implode(',', $this->_buffer) . $this->_createSuffix();
+	}
+
+	/**
+	 *  Create the LOAD DATA statement for the given file
+	 *  @name    _createLoadStatement
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string file
+	 *  @returns string query
+	 */
+	protected function _createLoadStatement(string $file):string {
+		return 'LOAD DATA LOCAL INFILE ' . $this->call('../quote', $file) . ' INTO TABLE ' . $this->_quoteName($this->_table) .
+			' FIELDS TERMINATED BY \'\\t\' ESCAPED BY \'\\\\\' LINES TERMINATED BY \'\\n\'' .
+			' (' . $this->_quoteColumns() . ')';
+	}
+
+	/**
+	 *  Create the statement up to (and including) VALUES
+	 *  @name    _createPrefix
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns string prefix
+	 */
+	protected function _createPrefix():string {
+		return 'INSERT INTO ' . $this->_quoteName($this->_table) . ' (' . $this->_quoteColumns() . ') VALUES ';
+	}
+
+	/**
+	 *  Create the ON DUPLICATE KEY UPDATE clause (if any columns are to be updated)
+	 *  @name    _createSuffix
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns string suffix
+	 */
+	protected function _createSuffix():string {
+		if (!count($this->_update)) {
+			return '';
+		}
+
+		$update = Array();
+		foreach ($this->_update as $column) {
+			$update[] = $this->_quoteName($column) . '=VALUES(' . $this->_quoteName($column) . ')';
+		}
+
+		return ' ON DUPLICATE KEY UPDATE ' . implode(',', $update);
+	}
+
+	/**
+	 *  Format the values as VALUES tuple
+	 *  @name    _formatTuple
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  values
+	 *  @returns string tuple
+	 */
+	protected function _formatTuple(array $value):string {
+		$result = Array();
+		foreach ($value as $item) {
+			if (is_null($item)) {
+				$result[] = 'NULL';
+			}
+			else if (is_bool($item)) {
+				$result[] = (int) $item;
+			}
+			else if (is_int($item) || is_float($item)) {
+				$result[] = $item;
+			}
+			else {
+				$result[] = $this->call('../quote', (string) $item);
+			}
+		}
+
+		return '(' . implode(',', $result) . ')';
+	}
+
+	/**
+	 *  Format the values as tab separated line for LOAD DATA
+	 *  @name    _formatLine
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  values
+	 *  @returns string line
+	 */
+	protected function _formatLine(array $value):string {
+		$result = Array();
+		foreach ($value as $item) {
+			if (is_null($item)) {
+				$result[] = '\\N';
+			}
+			else {
+				$result[] = strtr(is_bool($item) ? (string) (int) $item : (string) $item, Array(
+					'\\' => '\\\\',
+					"\t" => '\\t',
+					"\n" => '\\n',
+					"\r" => '\\r',
+					"\0" => '\\0'
+				));
+			}
+		}
+
+		return implode("\t", $result);
+	}
+
+	/**
+	 *  Create the quoted column list
+	 *  @name    _quoteColumns
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns string columns
+	 */
+	protected function _quoteColumns():string {
+		$result = Array();
+		foreach ($this->_column as $column) {
+			$result[] = $this->_quoteName($column);
+		}
+
+		return implode(',', $result);
+	}
+
+	/**
+	 *  Quote a table or column name
+	 *  @name    _quoteName
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string name
+	 *  @returns string quoted name
+	 */
+	protected function _quoteName(string $name):string {
+		$result = Array();
+		foreach (explode('.', $name) as $part) {
+			$result[] = '`' . str_replace('`', '``', $part) . '`';
+		}
+
+		return implode('.', $result);
+	}
+
+	/**
+	 *  Obtain the maximum size of the buffered rows for a single statement
+	 *  @name    _getLimit
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns int bytes
+	 *  @note    For MODE_INSERT this is max_allowed_packet minus the size of the statement itself, LOAD DATA streams
+	 *           the file and is only limited by the number of rows
+	 */
+	protected function _getLimit():int {
+		if ($this->_mode === self::MODE_LOAD) {
+			return PHP_INT_MAX;
+		}
+
+		if (!$this->_limit) {
+			//  the server variables are cached, so this does not cost a query per batch
+			$packet = (int) $this->get('../Info/Variable/max_allowed_packet', 1048576);
+
+			//  leave room for the statement itself and the protocol overhead
+			$this->_limit = max(1024, $packet - strlen($this->_createPrefix() . $this->_createSuffix()) - 1024);
+		}
+
+		return $this->_limit;
+	}
+
+	/**
+	 *  Obtain the maximum number of rows for a single statement
+	 *  @name    _getRowLimit
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns int rows
+	 */
+	protected function _getRowLimit():int {
+		return max(1, (int) $this->get('/Config/MySQLi/batchrows', $this->_mode === self::MODE_LOAD ? 50000 : 1000));
+	}
+}
@@ -0,0 +1,716 @@
+<?hh  //  strict
+
+
+/**
+ *  Query result cache, holding materialised results limited in size (least recently used entries are evicted first)
+ *  and time. Entries are tagged (usually with the tables involved), invalidating a tag drops all entries carrying it.
+ *  If enabled and available, the APC user cache is used to share entries and tag versions between processes.
+ *  Large result sets can be packed (compressed in chunks) and spilled to disk before they are stored, see pack
+ *  @name    CoreDBMySQLiCache
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ */
+class CoreDBMySQLiCache<Konsolidate> extends Konsolidate {
+	const TAG_ALL = '*';  //  carried by every entry, invalidating it drops all entries of the namespace
+
+	/**
+	 *  The namespace, keeping entries of different databases apart
+	 *  @name    _namespace
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_namespace;
+
+	/**
+	 *  The local entries (least recently used first)
+	 *  @name    _entry
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, array> $_entry;
+
+	/**
+	 *  The local tag versions (used if the cache is not shared)
+	 *  @name    _version
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_version;
+
+	/**
+	 *  The total size of the local entries in bytes
+	 *  @name    _size
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_size;
+
+	/**
+	 *  The maximum total size of the local entries in bytes
+	 *  @name    _limit
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_limit;
+
+	/**
+	 *  The default time to live in seconds
+	 *  @name    _ttl
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_ttl;
+
+	/**
+	 *  Whether or not the APC user cache is used to share entries between processes
+	 *  @name    _shared
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_shared;
+
+	/**
+	 *  The packing settings (compress and spill thresholds in bytes, rows per chunk, codec and spill directory)
+	 *  @name    _setting
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, mixed> $_setting;
+
+	/**
+	 *  The hit/miss/store/eviction/expiration/invalidation counters
+	 *  @name    _metric
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, int> $_metric;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @param   string namespace (optional, default none)
+	 *  @param   string configuration prefix (optional, default '/Config/MySQLi/cache')
+	 *  @param   bool   shared if not configured (optional, default false)
+	 *  @returns object
+	 *  @note    The size (bytes), ttl (seconds) and shared (bool) settings are read from the configuration prefix,
+	 *           e.g. /Config/MySQLi/cachesize, /Config/MySQLi/cachettl and /Config/MySQLi/cacheshared, as are the
+	 *           packing settings compress, spill (bytes, 0 to disable), spillttl (seconds, the maximum lifetime of a
+	 *           spill file), chunk (rows), codec and spilldir
+	 */
+	public function __construct(Konsolidate $parent, string $namespace='', string $config='/Config/MySQLi/cache', bool $shared=false) {
+		parent::__construct($parent);
+
+		$this->_namespace = $namespace;
+		$this->_entry     = Map<string, array> {};
+		$this->_version   = Map<string, string> {};
+		$this->_size      = 0;
+		$this->_limit     = (int) $this->get($config . 'size', 4194304);
+		$this->_ttl       = (int) $this->get($config . 'ttl', 60);
+		$this->_shared    = function_exists('apc_fetch') && (bool) $this->get($config . 'shared', $shared);
+		$this->_setting   = Map<string, mixed> {
+			'compress'  => max(0, (int) $this->get($config . 'compress', 65536)),
+			'spill'     => max(0, (int) $this->get($config . 'spill', 1048576)),
+			'spillttl'  => max(1, (int) $this->get($config . 'spillttl', 3600)),
+			'chunk'     => max(1, (int) $this->get($config . 'chunk', 1000)),
+			'codec'     => $this->_getCodec((string) $this->get($config . 'codec', '')),
+			'directory' => rtrim((string) $this->get($config . 'spilldir', sys_get_temp_dir() . '/konsolidate-cache-' . (function_exists('posix_geteuid') ? posix_geteuid() : get_current_user())), '/')
+		};
+		$this->_metric    = Map<string, int> {
+			'hit'          => 0,
+			'miss'         => 0,
+			'store'        => 0,
+			'eviction'     => 0,
+			'expiration'   => 0,
+			'invalidation' => 0,
+			'compressed'   => 0,
+			'spilled'      => 0
+		};
+	}
+
+	/**
+	 *  Obtain a cached value
+	 *  @name    fetch
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string key
+	 *  @returns mixed  value (null if not cached)
+	 */
+	public function fetch(string $key):mixed {
+		if ($this->_entry->contains($key)) {
+			$entry = $this->_entry->get($key);
+			$this->_entry->remove($key);
+
+			if ($this->_isValid($entry)) {
+				//  re-add the entry, marking it as most recently used
+				$this->_entry->set($key, $entry);
+				$this->_metric['hit']++;
+
+				return $entry['value'];
+			}
+
+			$this->_size -= $entry['size'];
+			$this->_release($entry);
+		}
+
+		if ($this->_shared) {
+			$success = false;
+			$entry   = apc_fetch($this->_sharedKey($key), $success);
+
+			if ($success && $this->_isValid($entry)) {
+				$this->_local($key, $entry);
+				$this->_metric['hit']++;
+
+				return $entry['value'];
+			}
+		}
+
+		$this->_metric['miss']++;
+
+		return null;
+	}
+
+	/**
+	 *  Store a value
+	 *  @name    store
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string key
+	 *  @param   mixed  value
+	 *  @param   Vector tags (optional, default none)
+	 *  @param   int    time to live in seconds (optional, default the configured ttl)
+	 *  @returns bool   stored
+	 */
+	public function store(string $key, mixed $value, ?Vector<string> $tag=null, ?int $ttl=null):bool {
+		$ttl   = is_null($ttl) ? $this->_ttl : $ttl;
+		$entry = Array(
+			'value'  => $value,
+			'size'   => strlen(serialize($value)),
+			'expire' => $ttl > 0 ? time() + $ttl : 0,
+			'tag'    => Array(self::TAG_ALL => $this->_tagVersion(self::TAG_ALL)),
+			'file'   => $this->_getFiles($value)
+		);
+
+		if ($tag) {
+			foreach ($tag as $name) {
+				$entry['tag'][$name] = $this->_tagVersion($name);
+			}
+		}
+
+		$this->remove($key);
+		if ($entry['size'] > $this->_limit) {
+			$this->_release($entry);
+
+			return false;
+		}
+
+		$this->_local($key, $entry);
+		$this->_metric['store']++;
+
+		if ($this->_shared) {
+			apc_store($this->_sharedKey($key), $entry, $ttl);
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Remove a value
+	 *  @name    remove
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string key
+	 *  @returns void
+	 */
+	public function remove(string $key):void {
+		if ($this->_entry->contains($key)) {
+			$this->_size -= $this->_entry->get($key)['size'];
+			$this->_release($this->_entry->get($key));
+			$this->_entry->remove($key);
+		}
+
+		if ($this->_shared) {
+			apc_delete($this->_sharedKey($key));
+		}
+	}
+
+	/**
+	 *  Invalidate all entries carrying any of the given tags
+	 *  @name    invalidate
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable tags
+	 *  @returns void
+	 *  @note    Changing the tag version makes the entries stale, both in this process and (if shared) in all others.
+	 *           Local entries of a cache which is not shared are removed right away, releasing their spill files.
+	 *           Invalidating TAG_ALL makes all entries of the namespace stale
+	 */
+	public function invalidate(Traversable<string> $tag):void {
+		$invalid = Set<string> {};
+		foreach ($tag as $name) {
+			$version = uniqid('', true);
+
+			if ($this->_shared) {
+				apc_store($this->_sharedKey('tag:' . $name), $version);
+			}
+			$this->_version->set($name, $version);
+			$this->_metric['invalidation']++;
+			$invalid->add($name);
+		}
+
+		if (!$this->_shared) {
+			foreach ($this->_entry->toArray() as $key=>$entry) {
+				if (count(array_intersect_key($entry['tag'], $invalid->toArray()))) {
+					$this->remove((string) $key);
+				}
+			}
+		}
+	}
+
+	/**
+	 *  Pack result rows for storage, compressing them in chunks if they exceed the compress threshold and writing the
+	 *  chunks to a file if the compressed chunks still exceed the spill threshold
+	 *  @name    pack
+	 *  @type    method
+	 *  @access  public
+	 *  @param   array  result rows
+	 *  @param   int    time to live in seconds (optional, default the configured ttl, at most spillttl), after which a
+	 *                  spill file may be removed
+	 *  @returns array  result rows (unchanged if below the threshold) or packed rows (see isPacked)
+	 *  @note    Packed rows are decoded one chunk at a time (see unpack), so iterating a large cached result only
+	 *           requires a single chunk in memory. Codecs are lz4, zstd (if the extensions are available) or gzip
+	 */
+	public function pack(array $records, ?int $ttl=null):array {
+		$codec = $this->_setting['codec'];
+
+		if (!$codec || !$this->_setting['compress'] || strlen(serialize($records)) < $this->_setting['compress']) {
+			return $records;
+		}
+
+		$chunk = Array();
+		$size  = 0;
+		foreach (array_chunk($records, $this->_setting['chunk']) as $rows) {
+			$data    = $this->_encode($codec, serialize($rows));
+			$chunk[] = $data;
+			$size   += strlen($data);
+		}
+		$this->_metric['compressed']++;
+
+		$packed = Array('codec' => $codec, 'rows' => count($records), 'chunk' => $chunk);
+		if ($this->_setting['spill'] > 0 && $size > $this->_setting['spill']) {
+			//  spill files always expire, entries living longer than the file become unavailable (see isAvailable)
+			$ttl  = is_null($ttl) ? $this->_ttl : $ttl;
+			$file = $this->_spill($chunk, time() + ($ttl > 0 ? min($ttl, $this->_setting['spillttl']) : $this->_setting['spillttl']));
+
+			if ($file) {
+				list($packed['file'], $packed['chunk']) = $file;
+				$this->_metric['spilled']++;
+			}
+		}
+
+		return $packed;
+	}
+
+	/**
+	 *  Decode a chunk of packed result rows
+	 *  @name    unpack
+	 *  @type    method
+	 *  @access  public
+	 *  @param   array  packed rows
+	 *  @param   int    chunk
+	 *  @returns array  result rows (empty if the chunk cannot be read)
+	 */
+	public function unpack(array $packed, int $index):array {
+		if (!isset($packed['chunk'][$index])) {
+			return Array();
+		}
+
+		if (isset($packed['file'])) {
+			list($offset, $length) = $packed['chunk'][$index];
+			$opened = isset($packed['handle']) && is_resource($packed['handle']);
+			$handle = $opened ? $packed['handle'] : @fopen($packed['file'], 'rb');
+			$data   = $handle && fseek($handle, $offset) === 0 ? fread($handle, $length) : false;
+
+			if ($handle && !$opened) {
+				fclose($handle);
+			}
+
+			if ($data === false || strlen($data) !== $length) {
+				$this->call('/Log/write', get_class($this) . ' cannot read chunk ' . $index . ' from ' . $packed['file'], 2);
+
+				return Array();
+			}
+		}
+		else {
+			$data = $packed['chunk'][$index];
+		}
+
+		$rows = @unserialize($this->_decode($packed['codec'], $data));
+
+		return is_array($rows) ? $rows : Array();
+	}
+
+	/**
+	 *  Open the spill file of packed result rows (if any), so the rows remain readable if the file is removed while
+	 *  they are being read
+	 *  @name    open
+	 *  @type    method
+	 *  @access  public
+	 *  @param   array  packed rows
+	 *  @returns array  packed rows (holding the file handle)
+	 */
+	public function open(array $packed):array {
+		if (isset($packed['file']) && !isset($packed['handle'])) {
+			$handle = @fopen($packed['file'], 'rb');
+			if ($handle) {
+				$packed['handle'] = $handle;
+			}
+		}
+
+		return $packed;
+	}
+
+	/**
+	 *  Determine whether the given value holds packed result rows
+	 *  @name    isPacked
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  value
+	 *  @returns bool   packed
+	 */
+	public function isPacked(mixed $value):bool {
+		return is_array($value) && isset($value['codec'], $value['rows'], $value['chunk']) && is_string($value['codec']);
+	}
+
+	/**
+	 *  Determine whether the given value can be read (spilled rows require their file to exist)
+	 *  @name    isAvailable
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  value
+	 *  @returns bool   available
+	 */
+	public function isAvailable(mixed $value):bool {
+		return !$this->isPacked($value) || !isset($value['file']) || is_file($value['file']);
+	}
+
+	/**
+	 *  Remove all local entries
+	 *  @name    clear
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function clear():void {
+		foreach ($this->_entry as $entry) {
+			$this->_release($entry);
+		}
+		$this->_entry->clear();
+		$this->_size = 0;
+	}
+
+	/**
+	 *  Obtain the cache metrics
+	 *  @name    metrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function metrics():Map<string, mixed> {
+		$result = Map<string, mixed> {};
+		$result->setAll($this->_metric);
+		$result->set('entries', count($this->_entry));
+		$result->set('size', $this->_size);
+		$result->set('limit', $this->_limit);
+		$result->set('codec', $this->_setting['codec']);
+		$result->set('ratio', $this->_metric['hit'] + $this->_metric['miss'] > 0 ? $this->_metric['hit'] / ($this->_metric['hit'] + $this->_metric['miss']) : 0);
+
+		return $result;
+	}
+
+	/**
+	 *  Add an entry to the local store, evicting the least recently used entries until it fits
+	 *  @name    _local
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string key
+	 *  @param   array  entry
+	 *  @returns void
+	 */
+	protected function _local(string $key, array $entry):void {
+		while (count($this->_entry) && $this->_size + $entry['size'] > $this->_limit) {
+			$this->_size -= $this->_entry->get($this->_entry->firstKey())['size'];
+			$this->_release($this->_entry->get($this->_entry->firstKey()));
+			$this->_entry->remove($this->_entry->firstKey());
+			$this->_metric['eviction']++;
+		}
+
+		$this->_entry->set($key, $entry);
+		$this->_size += $entry['size'];
+	}
+
+	/**
+	 *  Verify whether an entry has not expired and none of its tags were invalidated since it was stored
+	 *  @name    _isValid
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  entry
+	 *  @returns bool   valid
+	 */
+	protected function _isValid(array $entry):bool {
+		if ($entry['expire'] > 0 && $entry['expire'] < time()) {
+			$this->_metric['expiration']++;
+
+			return false;
+		}
+
+		foreach ($entry['tag'] as $name=>$version) {
+			if ($this->_tagVersion($name) !== $version) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Obtain the current version of a tag
+	 *  @name    _tagVersion
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string tag
+	 *  @returns string version
+	 *  @note    A missing shared version (never set, or evicted from APC) is initialised with a unique value, so entries
+	 *           stored before the eviction can never become valid again
+	 */
+	protected function _tagVersion(string $name):string {
+		if ($this->_shared) {
+			$key     = $this->_sharedKey('tag:' . $name);
+			$version = apc_fetch($key);
+
+			if ($version === false) {
+				apc_add($key, uniqid('', true));
+				$version = apc_fetch($key);
+			}
+
+			return (string) $version;
+		}
+
+		if (!$this->_version->contains($name)) {
+			$this->_version->set($name, uniqid('', true));
+		}
+
+		return $this->_version->get($name);
+	}
+
+	/**
+	 *  Determine the codec to compress with, the configured codec or the fastest available one
+	 *  @name    _getCodec
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string configured codec (empty for the fastest available)
+	 *  @returns string codec (null if none is available)
+	 */
+	protected function _getCodec(string $codec):?string {
+		$available = Map<string, string> {'lz4' => 'lz4_compress', 'zstd' => 'zstd_compress', 'gzip' => 'gzcompress'};
+
+		if ($codec && $available->contains($codec) && function_exists($available->get($codec))) {
+			return $codec;
+		}
+
+		foreach ($available as $name=>$function) {
+			if (function_exists($function)) {
+				return $name;
+			}
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Compress data
+	 *  @name    _encode
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string codec
+	 *  @param   string data
+	 *  @returns string compressed data
+	 */
+	protected function _encode(string $codec, string $data):string {
+		switch ($codec) {
+			case 'lz4':  return lz4_compress($data);
+			case 'zstd': return zstd_compress($data);
+		}
+
+		return gzcompress($data, 1);
+	}
+
+	/**
+	 *  Decompress data
+	 *  @name    _decode
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string codec
+	 *  @param   string compressed data
+	 *  @returns string data
+	 */
+	protected function _decode(string $codec, string $data):string {
+		switch ($codec) {
+			case 'lz4':  return (string) lz4_uncompress($data);
+			case 'zstd': return (string) zstd_uncompress($data);
+		}
+
+		return (string) gzuncompress($data);
+	}
+
+	/**
+	 *  Write compressed chunks to a spill file
+	 *  @name    _spill
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  compressed chunks
+	 *  @param   int    expiration (unix timestamp, 0 for none)
+	 *  @returns array  file and the offset and length of every chunk (null if the file cannot be written)
+	 *  @note    The expiration is part of the file name, expired files are removed by _collectGarbage. Files are never
+	 *           removed before they expire, as (shared) entries in other processes may still refer to them. The files
+	 *           hold database rows, so they are only readable by the owner and kept in a private directory
+	 */
+	protected function _spill(array $chunk, int $expire):?array {
+		$file = $this->_setting['directory'] . '/konsolidate-cache-' . $expire . '-' . md5(uniqid($this->_namespace, true));
+
+		if (!$this->_isPrivateDirectory($this->_setting['directory'])) {
+			$this->call('/Log/write', get_class($this) . ' cannot spill to ' . $this->_setting['directory'] . ', it is not a private directory, keeping the result in memory', 2);
+
+			return null;
+		}
+		$this->_collectGarbage();
+
+		$umask  = umask(0077);
+		$handle = @fopen($file, 'xb');
+		umask($umask);
+		$offset = Array();
+		$total  = 0;
+
+		if ($handle) {
+			foreach ($chunk as $data) {
+				if (fwrite($handle, $data) !== strlen($data)) {
+					break;
+				}
+				$offset[] = Array($total, strlen($data));
+				$total   += strlen($data);
+			}
+			fclose($handle);
+			@chmod($file, 0600);
+
+			if (count($offset) === count($chunk)) {
+				return Array($file, $offset);
+			}
+			@unlink($file);
+		}
+
+		$this->call('/Log/write', get_class($this) . ' cannot spill to ' . $file . ', keeping the result in memory', 3);
+
+		return null;
+	}
+
+	/**
+	 *  Verify the spill directory is only accessible by the owner of the process, creating it if needed
+	 *  @name    _isPrivateDirectory
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string directory
+	 *  @returns bool   private
+	 */
+	protected function _isPrivateDirectory(string $directory):bool {
+		if (!is_dir($directory) && !@mkdir($directory, 0700, true) && !is_dir($directory)) {
+			return false;
+		}
+
+		if (function_exists('posix_geteuid') && fileowner($directory) !== posix_geteuid()) {
+			return false;
+		}
+
+		return (fileperms($directory) & 0077) === 0 || @chmod($directory, 0700);
+	}
+
+	/**
+	 *  Obtain the spill files referred to by a value (packed rows, or an array holding packed rows)
+	 *  @name    _getFiles
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   mixed  value
+	 *  @returns array  files
+	 */
+	protected function _getFiles(mixed $value):array {
+		$file = Array();
+
+		if ($this->isPacked($value)) {
+			$value = Array($value);
+		}
+		if (is_array($value)) {
+			foreach ($value as $item) {
+				if ($this->isPacked($item) && isset($item['file'])) {
+					$file[] = $item['file'];
+				}
+			}
+		}
+
+		return $file;
+	}
+
+	/**
+	 *  Remove the spill files of a dropped entry
+	 *  @name    _release
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  entry
+	 *  @returns void
+	 *  @note    Files of a shared cache may still be referred to by other processes, these are left to _collectGarbage
+	 */
+	protected function _release(array $entry):void {
+		if (!$this->_shared && isset($entry['file'])) {
+			foreach ($entry['file'] as $file) {
+				@unlink($file);
+			}
+		}
+	}
+
+	/**
+	 *  Remove expired spill files (at most once a minute per process)
+	 *  @name    _collectGarbage
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns void
+	 */
+	protected function _collectGarbage():void {
+		static $collected = 0;
+
+		if ($collected > time() - 60) {
+			return;
+		}
+		$collected = time();
+
+		foreach (glob($this->_setting['directory'] . '/konsolidate-cache-*') ?: Array() as $file) {
+			$expire = (int) explode('-', substr(basename($file), 18), 2)[0];
+
+			if ($expire < $collected) {
+				@unlink($file);
+			}
+		}
+	}
+
+	/**
+	 *  Prefix the key so entries do not collide with other APC users (or other databases)
+	 *  @name    _sharedKey
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string key
+	 *  @returns string key
+	 */
+	protected function _sharedKey(string $key):string {
+		return __CLASS__ . ':' . $this->_namespace . ':' . $key;
+	}
+}
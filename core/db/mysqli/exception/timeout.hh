@@ -0,0 +1,12 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQLi timeout Exception class, the statement exceeded its deadline (MAX_EXECUTION_TIME, cancelled by KILL QUERY or
+ *  not executed at all as the request time budget was exhausted)
+ *  @name    CoreDBMySQLiExceptionTimeout
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ */
+class CoreDBMySQLiExceptionTimeout<CoreDBMySQLiException> extends CoreDBMySQLiException {
+}
@@ -0,0 +1,386 @@
+<?hh  //  strict
+
+
+/**
+ *  Fake MySQL server, answering the queries of fake connections (see CoreDBMySQLiFakeConnection) by scripted responses
+ *  or (if configured) an SQLite database, optionally with an injected latency
+ *  @name    CoreDBMySQLiFake
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    The fake server is enabled by the fake option of the DSN, like:
+ *           mysqli://user@host/database?fake[&sqlite=path&latency=ms&jitter=ms&lag=seconds], where sqlite is a file or
+ *           :memory:, latency (and a random jitter up to the given value) is added to every roundtrip and lag is
+ *           reported as replication lag (SHOW SLAVE STATUS). The connections are handed out by CoreDBMySQLiPool, so
+ *           the pool, result cache, retry, timeout and transaction handling of CoreDBMySQLi are used as they are
+ *           against a server. Use CoreDBMySQLi::fake to obtain the fake server of a connection.
+ *           Asynchronous execution cannot be exercised, as the fake connections refuse MYSQLI_ASYNC: genQuery and
+ *           queryAll execute the queries one at a time on side connections, without concurrency or the cancellation of
+ *           queries exceeding the timeout (see bin/db-fake-exercise)
+ */
+class CoreDBMySQLiFake<Konsolidate> extends Konsolidate {
+	/**
+	 *  The options (from the query string of the DSN)
+	 *  @name    _option
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_option;
+
+	/**
+	 *  The scripted responses (pattern => response), in the order they were added
+	 *  @name    _script
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<Pair<string, mixed>> $_script;
+
+	/**
+	 *  The queries received
+	 *  @name    _history
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<string> $_history;
+
+	/**
+	 *  The SQLite database
+	 *  @name    _sqlite
+	 *  @type    SQLite3
+	 *  @access  protected
+	 */
+	protected ?SQLite3 $_sqlite;
+
+	/**
+	 *  The ID of the last inserted record
+	 *  @name    _insertID
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_insertID;
+
+	/**
+	 *  The number of connections opened (used as thread id)
+	 *  @name    _thread
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_thread;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @param   Map    options (from the query string of the DSN)
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent, Map<string, string> $option) {
+		parent::__construct($parent);
+
+		$this->_option   = $option;
+		$this->_script   = Vector<Pair<string, mixed>> {};
+		$this->_history  = Vector<string> {};
+		$this->_sqlite   = null;
+		$this->_insertID = 0;
+		$this->_thread   = 0;
+	}
+
+	/**
+	 *  Open a connection to the fake server
+	 *  @name    open
+	 *  @type    method
+	 *  @access  public
+	 *  @returns CoreDBMySQLiFakeConnection connection
+	 *  @throws  Exception if an SQLite database is configured but SQLite3 is not available
+	 */
+	public function open():CoreDBMySQLiFakeConnection {
+		if ($this->_option->contains('sqlite') && !$this->_sqlite) {
+			if (!class_exists('SQLite3')) {
+				$this->exception('SQLite3 is not available for the fake database "' . $this->_option->get('sqlite') . '"');
+			}
+			$this->_sqlite = new SQLite3($this->_option->get('sqlite'));
+		}
+
+		$this->import('result.hh');
+		$this->import('statement.hh');
+		$this->import('connection.hh');
+		$this->_wait();
+
+		return new CoreDBMySQLiFakeConnection($this, ++$this->_thread);
+	}
+
+	/**
+	 *  Add a scripted response
+	 *  @name    script
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string pattern (the query, a regular expression delimited by '/', or a query with the same fingerprint)
+	 *  @param   mixed  response (result rows, number of affected rows, an Exception or a callable receiving the query)
+	 *  @returns void
+	 *  @note    The first matching response is used, if none match the query is executed by SQLite (if configured),
+	 *           otherwise the result is empty
+	 */
+	public function script(string $pattern, mixed $response):void {
+		$this->_script->add(Pair {$pattern, $response});
+	}
+
+	/**
+	 *  Obtain the queries received
+	 *  @name    history
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Vector queries
+	 */
+	public function history():Vector<string> {
+		return $this->_history;
+	}
+
+	/**
+	 *  Remove all scripted responses and the history
+	 *  @name    reset
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function reset():void {
+		$this->_script->clear();
+		$this->_history->clear();
+	}
+
+	/**
+	 *  Set the latency added to every roundtrip
+	 *  @name    setLatency
+	 *  @type    method
+	 *  @access  public
+	 *  @param   float  latency in milliseconds
+	 *  @param   float  maximum random jitter in milliseconds (optional, default 0)
+	 *  @returns void
+	 */
+	public function setLatency(float $latency, float $jitter=0.0):void {
+		$this->_option->set('latency', (string) $latency);
+		$this->_option->set('jitter', (string) $jitter);
+	}
+
+	/**
+	 *  Answer given query
+	 *  @name    respond
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns mixed  response (result rows, number of affected rows or Exception)
+	 */
+	public function respond(string $query):mixed {
+		$this->_history->add($query);
+		$this->_wait();
+
+		$response = $this->_match($query);
+		if (is_callable($response)) {
+			$response = call_user_func($response, $query);
+		}
+		else if (is_null($response)) {
+			if ($this->_option->contains('lag') && preg_match('/^\s*SHOW\s+SLAVE\s+STATUS\b/i', $query)) {
+				$response = Array(Array('Seconds_Behind_Master' => (int) $this->_option->get('lag')));
+			}
+			else {
+				$response = $this->_sqlite ? $this->_execute($query) : Array();
+			}
+		}
+
+		if (!$this->_sqlite && is_numeric($response) && preg_match('/^\s*(INSERT|REPLACE)\b/i', $query)) {
+			++$this->_insertID;
+		}
+
+		return $response;
+	}
+
+	/**
+	 *  get the ID of the last inserted record
+	 *  @name    lastInsertID
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int id
+	 */
+	public function lastInsertID():int {
+		return $this->_insertID;
+	}
+
+	/**
+	 *  Substitute the parameters of a prepared statement in its query
+	 *  @name    substitute
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (with placeholders)
+	 *  @param   array  parameters
+	 *  @returns string query
+	 *  @note    The parameters are substituted, so responses are matched against the complete query
+	 */
+	public function substitute(string $query, array $param):string {
+		$output = '';
+		$offset = 0;
+
+		foreach ($this->call('../Tokenizer/tokenize', $query) as $token) {
+			//  whitespace is omitted from the tokens, the text in between is copied as is
+			$position = strpos($query, $token[1], $offset);
+			$output  .= substr($query, $offset, $position - $offset);
+			$output  .= $token[0] === CoreDBMySQLiTokenizer::TOKEN_PLACEHOLDER && count($param) ? $this->_format(array_shift($param)) : $token[1];
+			$offset   = $position + strlen($token[1]);
+		}
+
+		return $output . substr($query, $offset);
+	}
+
+	/**
+	 *  Split a multi statement query into its statements
+	 *  @name    split
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns Vector statements
+	 */
+	public function split(string $query):Vector<string> {
+		$result = Vector<string> {};
+		$start  = 0;
+		$offset = 0;
+
+		foreach ($this->call('../Tokenizer/tokenize', $query) as $token) {
+			$offset = strpos($query, $token[1], $offset) + strlen($token[1]);
+
+			if ($token[0] === CoreDBMySQLiTokenizer::TOKEN_OPERATOR && $token[1] === ';') {
+				$statement = trim(substr($query, $start, $offset - 1 - $start));
+				if ($statement !== '') {
+					$result->add($statement);
+				}
+				$start = $offset;
+			}
+		}
+
+		$statement = trim(substr($query, $start));
+		if ($statement !== '') {
+			$result->add($statement);
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Properly escape a string
+	 *  @name    escape
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string escaped input
+	 *  @note    SQLite does not know backslash escapes, strings are escaped for the double quotes used by
+	 *           CoreDBMySQLi::quote instead
+	 */
+	public function escape(string $string):string {
+		if ($this->_option->contains('sqlite')) {
+			return str_replace('"', '""', $string);
+		}
+
+		return addcslashes($string, "\\\0\n\r'\"\x1a");
+	}
+
+	/**
+	 *  Find the scripted response for given query
+	 *  @name    _match
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns mixed  response (null if none matches)
+	 */
+	protected function _match(string $query):mixed {
+		$fingerprint = null;
+
+		foreach ($this->_script as $script) {
+			list($pattern, $response) = $script;
+
+			if ($pattern === $query || (substr($pattern, 0, 1) === '/' && @preg_match($pattern, $query))) {
+				return $response;
+			}
+
+			if (is_null($fingerprint)) {
+				$fingerprint = $this->call('../Tokenizer/normalise', $query);
+			}
+			if ($this->call('../Tokenizer/normalise', $pattern) === $fingerprint) {
+				return $response;
+			}
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Execute given query on the SQLite database
+	 *  @name    _execute
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @returns mixed  response (result rows, number of affected rows or Exception)
+	 */
+	protected function _execute(string $query):mixed {
+		//  SQLite knows transactions, but not by the MySQL syntax
+		$query     = preg_replace('/^\s*START\s+TRANSACTION\b/i', 'BEGIN', $query);
+		$statement = @$this->_sqlite->prepare($query);
+		$result    = $statement ? @$statement->execute() : false;
+
+		if (!$result) {
+			$this->import('../exception.hh');
+
+			return new CoreDBMySQLiException($this->_sqlite->lastErrorMsg(), $this->_sqlite->lastErrorCode() ?: 1);
+		}
+
+		if (!$result->numColumns()) {
+			$this->_insertID = $this->_sqlite->lastInsertRowID();
+
+			return $this->_sqlite->changes();
+		}
+
+		$records = Array();
+		while ($record = $result->fetchArray(SQLITE3_ASSOC)) {
+			$records[] = $record;
+		}
+
+		return $records;
+	}
+
+	/**
+	 *  Format a parameter value for substitution in the query
+	 *  @name    _format
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   mixed  value
+	 *  @returns string value
+	 */
+	protected function _format(mixed $value):string {
+		if (is_null($value)) {
+			return 'NULL';
+		}
+		else if (is_bool($value)) {
+			return (string) (int) $value;
+		}
+		else if (is_int($value) || is_float($value)) {
+			return (string) $value;
+		}
+
+		return '"' . $this->escape((string) $value) . '"';
+	}
+
+	/**
+	 *  Wait for the latency of a roundtrip
+	 *  @name    _wait
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns void
+	 */
+	protected function _wait():void {
+		$latency = (float) ($this->_option->get('latency') ?: 0);
+		$jitter  = (float) ($this->_option->get('jitter') ?: 0);
+		$delay   = (int) (($latency + ($jitter > 0 ? mt_rand(0, (int) ($jitter * 1000)) / 1000 : 0)) * 1000);
+
+		if ($delay > 0) {
+			usleep($delay);
+		}
+	}
+}
@@ -0,0 +1,381 @@
+<?hh  //  strict
+
+
+/**
+ *  Fake MySQLi connection, handed out by CoreDBMySQLiPool in place of a connection to a server, passing the queries to
+ *  its fake server (see CoreDBMySQLiFake)
+ *  @name    CoreDBMySQLiFakeConnection
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Asynchronous queries (MYSQLI_ASYNC) are refused, as mysqli_poll only accepts connections to a server, the
+ *           queries are executed synchronously instead (see CoreDBMySQLi::genQuery). Disabling autocommit starts a
+ *           transaction, which lasts until it is committed or rolled back
+ */
+class CoreDBMySQLiFakeConnection<MySQLi> extends MySQLi {
+	/**
+	 *  The MySQLi connection properties (read by CoreDBMySQLiQuery, CoreDBMySQLiException and CoreDBMySQLiInfo)
+	 *  @name    affected_rows, insert_id, errno, error, ...
+	 *  @type    mixed
+	 *  @access  public
+	 */
+	public int $affected_rows = 0;
+	public int $insert_id = 0;
+	public int $errno = 0;
+	public string $error = '';
+	public string $sqlstate = '00000';
+	public int $field_count = 0;
+	public int $warning_count = 0;
+	public ?string $info = null;
+	public int $thread_id = 0;
+	public string $server_info = '5.7.0-fake';
+	public int $server_version = 50700;
+	public string $client_info = '';
+	public int $client_version = 0;
+	public int $connect_errno = 0;
+	public ?string $connect_error = null;
+
+	/**
+	 *  The fake server
+	 *  @name    _server
+	 *  @type    CoreDBMySQLiFake
+	 *  @access  protected
+	 */
+	protected CoreDBMySQLiFake $_server;
+
+	/**
+	 *  Whether or not a transaction is going on
+	 *  @name    _transaction
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_transaction = false;
+
+	/**
+	 *  The result of the current statement of a multi statement query
+	 *  @name    _stored
+	 *  @type    mixed
+	 *  @access  protected
+	 */
+	protected mixed $_stored = false;
+
+	/**
+	 *  The remaining statements of a multi statement query
+	 *  @name    _remaining
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<string> $_remaining;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   CoreDBMySQLiFake server
+	 *  @param   int    thread id
+	 *  @returns object
+	 *  @note    The MySQLi constructor is not called, as it would connect to a server
+	 */
+	public function __construct(CoreDBMySQLiFake $server, int $thread) {
+		$this->_server        = $server;
+		$this->_remaining     = Vector<string> {};
+		$this->thread_id      = $thread;
+		$this->client_info    = mysqli_get_client_info();
+		$this->client_version = mysqli_get_client_version();
+	}
+
+	/**
+	 *  Obtain the fake server
+	 *  @name    server
+	 *  @type    method
+	 *  @access  public
+	 *  @returns CoreDBMySQLiFake server
+	 */
+	public function server():CoreDBMySQLiFake {
+		return $this->_server;
+	}
+
+	/**
+	 *  Query the fake server
+	 *  @name    query
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @param   int    result mode (optional, default MYSQLI_STORE_RESULT)
+	 *  @returns mixed  result (CoreDBMySQLiFakeResult, true for statements without a resultset, false on error)
+	 *  @note    Unbuffered results (MYSQLI_USE_RESULT) are buffered by the fake server
+	 */
+	public function query($query, $mode=MYSQLI_STORE_RESULT) {
+		if ($mode & MYSQLI_ASYNC) {
+			$this->errno = 2019;
+			$this->error = 'Asynchronous queries are not supported by fake connections';
+
+			return false;
+		}
+
+		return $this->_complete($this->_server->respond($query));
+	}
+
+	/**
+	 *  Query the fake server with multiple statements, the first statement is executed immediately, the others once
+	 *  the previous result has been read (see next_result)
+	 *  @name    multi_query
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string queries (separated by ';')
+	 *  @returns bool   success of the first statement
+	 */
+	public function multi_query($query) {
+		$this->_remaining = $this->_server->split($query);
+
+		return $this->next_result();
+	}
+
+	/**
+	 *  Determine whether there are more statements of a multi statement query
+	 *  @name    more_results
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function more_results() {
+		return count($this->_remaining) > 0;
+	}
+
+	/**
+	 *  Execute the next statement of a multi statement query
+	 *  @name    next_result
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool   success (false if the statement failed or there are no more statements)
+	 */
+	public function next_result() {
+		if (!count($this->_remaining)) {
+			return false;
+		}
+
+		$query = $this->_remaining[0];
+		$this->_remaining->removeKey(0);
+		$this->_stored = $this->query($query);
+
+		//  the server does not execute the statements following a failed statement
+		if ($this->_stored === false) {
+			$this->_remaining->clear();
+		}
+
+		return $this->_stored !== false;
+	}
+
+	/**
+	 *  Obtain the result of the current statement of a multi statement query
+	 *  @name    store_result
+	 *  @type    method
+	 *  @access  public
+	 *  @returns mixed  result (false if the statement has no resultset)
+	 */
+	public function store_result($option=0) {
+		$result = $this->_stored;
+		$this->_stored = false;
+
+		return $result instanceof MySQLi_Result ? $result : false;
+	}
+
+	/**
+	 *  Prepare a statement
+	 *  @name    prepare
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @returns CoreDBMySQLiFakeStatement statement
+	 */
+	public function prepare($query) {
+		return new CoreDBMySQLiFakeStatement($this, $query);
+	}
+
+	/**
+	 *  Turn autocommit on or off, turning it off starts a transaction, turning it on commits the transaction
+	 *  @name    autocommit
+	 *  @type    method
+	 *  @access  public
+	 *  @param   bool   autocommit
+	 *  @returns bool   success
+	 */
+	public function autocommit($mode) {
+		if (!$mode && !$this->_transaction) {
+			$this->_transaction = $this->query('START TRANSACTION') !== false;
+
+			return $this->_transaction;
+		}
+
+		return $mode ? $this->commit() : true;
+	}
+
+	/**
+	 *  Commit the transaction
+	 *  @name    commit
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool   success
+	 */
+	public function commit($flags=0, $name=null) {
+		return $this->_end('COMMIT');
+	}
+
+	/**
+	 *  Roll back the transaction
+	 *  @name    rollback
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool   success
+	 */
+	public function rollback($flags=0, $name=null) {
+		return $this->_end('ROLLBACK');
+	}
+
+	/**
+	 *  Verify the connection
+	 *  @name    ping
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool   alive
+	 */
+	public function ping() {
+		return true;
+	}
+
+	/**
+	 *  Escape a string (see CoreDBMySQLiFake::escape)
+	 *  @name    real_escape_string
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string escaped input
+	 */
+	public function real_escape_string($string) {
+		return $this->_server->escape($string);
+	}
+
+	/**
+	 *  Escape a string (alias of real_escape_string)
+	 *  @name    escape_string
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string escaped input
+	 */
+	public function escape_string($string) {
+		return $this->real_escape_string($string);
+	}
+
+	/**
+	 *  Obtain the server status
+	 *  @name    stat
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string status
+	 */
+	public function stat() {
+		return 'Uptime: 1  Threads: 1  Questions: ' . count($this->_server->history()) . '  Slow queries: 0  Opens: 0  Flush tables: 0  Open tables: 0  Queries per second avg: 0.000';
+	}
+
+	/**
+	 *  Obtain the character set of the connection
+	 *  @name    character_set_name
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string character set
+	 */
+	public function character_set_name() {
+		return 'utf8mb4';
+	}
+
+	/**
+	 *  Set the character set of the connection (ignored)
+	 *  @name    set_charset
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string character set
+	 *  @returns bool
+	 */
+	public function set_charset($charset) {
+		return true;
+	}
+
+	/**
+	 *  Set a connection option (ignored)
+	 *  @name    options
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    option
+	 *  @param   mixed  value
+	 *  @returns bool
+	 */
+	public function options($option, $value) {
+		return true;
+	}
+
+	/**
+	 *  Close the connection, rolling back the transaction (if any)
+	 *  @name    close
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function close() {
+		return $this->rollback();
+	}
+
+	/**
+	 *  Register the outcome of a statement
+	 *  @name    _complete
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   mixed  response (result rows, number of affected rows or Exception, see CoreDBMySQLiFake::respond)
+	 *  @returns mixed  result (CoreDBMySQLiFakeResult, true for statements without a resultset, false on error)
+	 */
+	protected function _complete(mixed $response):mixed {
+		$this->errno       = 0;
+		$this->error       = '';
+		$this->field_count = 0;
+
+		if ($response instanceof Exception) {
+			$this->errno         = $response instanceof CoreDBMySQLiException ? $response->errno : ($response->getCode() ?: 1);
+			$this->error         = $response instanceof CoreDBMySQLiException ? $response->error : $response->getMessage();
+			$this->affected_rows = -1;
+
+			return false;
+		}
+
+		if (is_array($response) || $response instanceof Traversable) {
+			$result = new CoreDBMySQLiFakeResult($response);
+			$this->affected_rows = $result->num_rows;
+			$this->field_count   = $result->field_count;
+
+			return $result;
+		}
+
+		$this->affected_rows = (int) $response;
+		$this->insert_id     = $this->_server->lastInsertID();
+
+		return true;
+	}
+
+	/**
+	 *  End the transaction (if any)
+	 *  @name    _end
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string statement (COMMIT or ROLLBACK)
+	 *  @returns bool   success
+	 */
+	protected function _end(string $statement):bool {
+		if ($this->_transaction) {
+			$this->_transaction = $this->query($statement) === false;
+
+			return !$this->_transaction;
+		}
+
+		return true;
+	}
+}
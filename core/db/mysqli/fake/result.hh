@@ -0,0 +1,240 @@
+<?hh  //  strict
+
+
+/**
+ *  Fake MySQLi result set, holding the rows of a response of the fake server (see CoreDBMySQLiFake)
+ *  @name    CoreDBMySQLiFakeResult
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    As with a connection to a server (without MYSQLI_OPT_INT_AND_FLOAT_NATIVE) the values are delivered as
+ *           strings, the column types are determined by the values of the first row which is not NULL
+ */
+class CoreDBMySQLiFakeResult<MySQLi_Result> extends MySQLi_Result {
+	/**
+	 *  The MySQLi result properties
+	 *  @name    num_rows, field_count, current_field
+	 *  @type    int
+	 *  @access  public
+	 */
+	public int $num_rows = 0;
+	public int $field_count = 0;
+	public int $current_field = 0;
+
+	/**
+	 *  The rows (by column name)
+	 *  @name    _records
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected array<array<string, ?string>> $_records;
+
+	/**
+	 *  The columns
+	 *  @name    _field
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected array<stdClass> $_field;
+
+	/**
+	 *  The position of the next row
+	 *  @name    _pointer
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_pointer = 0;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   Traversable rows (arrays or objects)
+	 *  @returns object
+	 *  @note    The MySQLi_Result constructor is not called, as there is no connection to read the rows from
+	 */
+	public function __construct(Traversable<mixed> $rows) {
+		$type           = Array();
+		$this->_records = Array();
+		$this->_field   = Array();
+
+		foreach ($rows as $row) {
+			$record = Array();
+			foreach ((array) $row as $name=>$value) {
+				if (!isset($type[$name]) && !is_null($value)) {
+					$type[$name] = is_int($value) || is_bool($value) ? MYSQLI_TYPE_LONGLONG : (is_float($value) ? MYSQLI_TYPE_DOUBLE : MYSQLI_TYPE_VAR_STRING);
+				}
+				$record[$name] = is_null($value) ? null : (string) (is_bool($value) ? (int) $value : $value);
+			}
+			$this->_records[] = $record;
+		}
+
+		if (count($this->_records)) {
+			foreach (array_keys($this->_records[0]) as $name) {
+				$this->_field[] = (object) Array(
+					'name'     => $name,
+					'orgname'  => $name,
+					'table'    => '',
+					'orgtable' => '',
+					'def'      => '',
+					'db'       => '',
+					'catalog'  => 'def',
+					'length'   => 0,
+					'flags'    => 0,
+					'decimals' => 0,
+					'type'     => isset($type[$name]) ? $type[$name] : MYSQLI_TYPE_NULL
+				);
+			}
+		}
+
+		$this->num_rows    = count($this->_records);
+		$this->field_count = count($this->_field);
+	}
+
+	/**
+	 *  Fetch the next row as associative array
+	 *  @name    fetch_assoc
+	 *  @type    method
+	 *  @access  public
+	 *  @returns array  row (null if there are no more rows)
+	 */
+	public function fetch_assoc() {
+		return $this->_pointer < count($this->_records) ? $this->_records[$this->_pointer++] : null;
+	}
+
+	/**
+	 *  Fetch the next row as numeric array
+	 *  @name    fetch_row
+	 *  @type    method
+	 *  @access  public
+	 *  @returns array  row (null if there are no more rows)
+	 */
+	public function fetch_row() {
+		$row = $this->fetch_assoc();
+
+		return is_array($row) ? array_values($row) : null;
+	}
+
+	/**
+	 *  Fetch the next row as associative, numeric or combined array
+	 *  @name    fetch_array
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    type (optional, default MYSQLI_BOTH)
+	 *  @returns array  row (null if there are no more rows)
+	 */
+	public function fetch_array($resulttype=MYSQLI_BOTH) {
+		$row = $this->fetch_assoc();
+
+		if (!is_array($row) || $resulttype === MYSQLI_ASSOC) {
+			return $row;
+		}
+
+		return $resulttype === MYSQLI_NUM ? array_values($row) : array_merge(array_values($row), $row);
+	}
+
+	/**
+	 *  Fetch the next row as object
+	 *  @name    fetch_object
+	 *  @type    method
+	 *  @access  public
+	 *  @returns object row (null if there are no more rows)
+	 */
+	public function fetch_object($class_name=null, $params=null) {
+		$row = $this->fetch_assoc();
+
+		return is_array($row) ? (object) $row : null;
+	}
+
+	/**
+	 *  Fetch all (remaining) rows
+	 *  @name    fetch_all
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    type (optional, default MYSQLI_NUM)
+	 *  @returns array  rows
+	 */
+	public function fetch_all($resulttype=MYSQLI_NUM) {
+		$result = Array();
+		while ($row = $this->fetch_array($resulttype)) {
+			$result[] = $row;
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Obtain the columns
+	 *  @name    fetch_fields
+	 *  @type    method
+	 *  @access  public
+	 *  @returns array  columns (objects with name and type, as MySQLi_Result provides them)
+	 */
+	public function fetch_fields() {
+		return $this->_field;
+	}
+
+	/**
+	 *  Obtain the column at the given position
+	 *  @name    fetch_field_direct
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    position
+	 *  @returns object column (false if there is no such column)
+	 */
+	public function fetch_field_direct($fieldnr) {
+		return isset($this->_field[$fieldnr]) ? $this->_field[$fieldnr] : false;
+	}
+
+	/**
+	 *  Move the pointer to the given row
+	 *  @name    data_seek
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    row
+	 *  @returns bool   success
+	 */
+	public function data_seek($offset) {
+		if ($offset < 0 || $offset >= $this->num_rows) {
+			return false;
+		}
+		$this->_pointer = $offset;
+
+		return true;
+	}
+
+	/**
+	 *  Free the result
+	 *  @name    free
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function free() {
+		$this->_records = Array();
+		$this->_pointer = 0;
+	}
+
+	/**
+	 *  Free the result (alias of free)
+	 *  @name    close
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function close() {
+		$this->free();
+	}
+
+	/**
+	 *  Free the result (alias of free)
+	 *  @name    free_result
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function free_result() {
+		$this->free();
+	}
+}
@@ -0,0 +1,157 @@
+<?hh  //  strict
+
+
+/**
+ *  Fake MySQLi prepared statement, substituting the bound parameters in the query which is passed to the fake server
+ *  (see CoreDBMySQLiFake::substitute)
+ *  @name    CoreDBMySQLiFakeStatement
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ */
+class CoreDBMySQLiFakeStatement<MySQLi_STMT> extends MySQLi_STMT {
+	/**
+	 *  The MySQLi statement properties
+	 *  @name    affected_rows, insert_id, errno, error, ...
+	 *  @type    mixed
+	 *  @access  public
+	 */
+	public int $affected_rows = 0;
+	public int $insert_id = 0;
+	public int $errno = 0;
+	public string $error = '';
+	public string $sqlstate = '00000';
+	public int $num_rows = 0;
+	public int $field_count = 0;
+	public int $param_count = 0;
+
+	/**
+	 *  The connection on which the statement was prepared
+	 *  @name    _conn
+	 *  @type    CoreDBMySQLiFakeConnection
+	 *  @access  protected
+	 */
+	protected CoreDBMySQLiFakeConnection $_conn;
+
+	/**
+	 *  The query
+	 *  @name    _query
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_query;
+
+	/**
+	 *  The bound parameters
+	 *  @name    _param
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected array $_param = Array();
+
+	/**
+	 *  The result of the last execution
+	 *  @name    _result
+	 *  @type    mixed
+	 *  @access  protected
+	 */
+	protected mixed $_result = false;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   CoreDBMySQLiFakeConnection connection
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @returns object
+	 *  @note    The MySQLi_STMT constructor is not called, as the statement is not prepared on a server
+	 */
+	public function __construct(CoreDBMySQLiFakeConnection $connection, string $query) {
+		$this->_conn       = $connection;
+		$this->_query      = $query;
+		$this->param_count = substr_count($query, '?');
+	}
+
+	/**
+	 *  Bind the parameters
+	 *  @name    bind_param
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string types (ignored, the values are substituted by their own type)
+	 *  @param   mixed  parameter N (by reference)
+	 *  @returns bool   success
+	 */
+	public function bind_param($types, &...$vars) {
+		$this->_param = $vars;
+
+		return true;
+	}
+
+	/**
+	 *  Execute the statement
+	 *  @name    execute
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool   success
+	 */
+	public function execute() {
+		$this->_result = $this->_conn->query($this->_conn->server()->substitute($this->_query, $this->_param));
+
+		$this->errno         = $this->_conn->errno;
+		$this->error         = $this->_conn->error;
+		$this->affected_rows = $this->_conn->affected_rows;
+		$this->insert_id     = $this->_conn->insert_id;
+		$this->field_count   = $this->_conn->field_count;
+		$this->num_rows      = $this->_result instanceof MySQLi_Result ? $this->_result->num_rows : 0;
+
+		return $this->_result !== false;
+	}
+
+	/**
+	 *  Obtain the result of the last execution
+	 *  @name    get_result
+	 *  @type    method
+	 *  @access  public
+	 *  @returns mixed  result (false if the statement has no resultset)
+	 */
+	public function get_result() {
+		return $this->_result instanceof MySQLi_Result ? $this->_result : false;
+	}
+
+	/**
+	 *  Buffer the result (the result is always buffered)
+	 *  @name    store_result
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function store_result() {
+		return true;
+	}
+
+	/**
+	 *  Reset the statement
+	 *  @name    reset
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function reset() {
+		$this->_param  = Array();
+		$this->_result = false;
+
+		return true;
+	}
+
+	/**
+	 *  Close the statement
+	 *  @name    close
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function close() {
+		return $this->reset();
+	}
+}
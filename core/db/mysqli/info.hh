@@ -44,15 +44,25 @@ class CoreDBMySQLiInfo<Konsolidate> extends Konsolidate {
 	 *  @param   string  group1
 	 *  @param   string  group...
 	 *  @return  void
+	 *  @note    the lazily collected groups (Variable, Status and Table) are loaded completely, the queries for all other
+	 *           groups are sent at once (see CoreDBMySQLi::pipeline)
 	 */
 	public function collect():void {
 		$arg = func_get_args();
 		if (!count($arg)) {
 			$arg = Array('Variable', 'Status', 'Table');
 		}
-		foreach ($arg as $module) {
-			$this->register($module);
+
+		$eager = Array();
+		foreach ($arg as $group) {
+			if ($this->checkModuleAvailability($group)) {
+				$this->register($group)->load();
+			}
+			else {
+				$eager[] = $group;
+			}
 		}
+		$this->_collect($eager);
 	}
 
 	/**
@@ -72,7 +82,7 @@ class CoreDBMySQLiInfo<Konsolidate> extends Konsolidate {
 	}
 
 	/**
-	 *  Automatically populate child modules (Variables, Table and Status if requested)
+	 *  Automatically populate child modules (Replication if requested), Variable, Status and Table are collected lazily
 	 *  @name    register
 	 *  @type    method
 	 *  @access  public
@@ -81,38 +91,93 @@ class CoreDBMySQLiInfo<Konsolidate> extends Konsolidate {
 	 *  @note    this method is an override to Konsolidates default behaviour
 	 */
 	public function register(string $module):object {
-		$instance = parent::register($module);
-		switch (strtolower($module)) {
-			case 'variable':
-				$result = $this->call('../query', 'SHOW VARIABLES');
-				if (is_object($result) && $result->errno <= 0 && (bool) $result->rows)
-					while ($record = $result->next())
-						$instance->set(strtolower($record->Variable_name), $record->Value);
-				break;
-
-			case 'status':
-				$result = $this->call('../query', 'SHOW GLOBAL STATUS');
-				if (is_object( $result ) && $result->errno <= 0 && (bool) $result->rows)
-					while ($record = $result->next())
-						$instance->set('Global/' . strtolower($record->Variable_name), $record->Value);
-
-				$result = $this->call('../query', 'SHOW SESSION STATUS');
-				if (is_object($result) && $result->errno <= 0 && (bool) $result->rows)
-					while ($record = $result->next())
-						$instance->set('Session/' . strtolower($record->Variable_name), $record->Value);
-				break;
-
-			case 'table':
-				$result = $this->call('../query', 'SHOW TABLE STATUS');
-				if (is_object($result) && $result->errno <= 0 && (bool) $result->rows)
-					while ($record = $result->next()) {
-						$sName = $record->Name;
-						foreach( $record as $sKey=>$sValue )
-							$instance->set($sName . '/' . strToLower($sKey ), $sValue);
-					}
-				break;
+		if ($this->checkModuleAvailability($module)) {
+			//  the lazily collected groups share their base class
+			$this->import('group.hh');
+		}
+		else if (!$this->_module->contains(strtoupper($module))) {
+			$this->_collect(Array($module));
+		}
+
+		return parent::register($module);
+	}
+
+	/**
+	 *  Obtain the queries (and the prefix for the collected values) populating an information group
+	 *  @name    _getGroupQueries
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string  group
+	 *  @return  Map     queries (query => prefix, a null prefix uses the name of each record)
+	 */
+	protected function _getGroupQueries(string $group):Map<string, ?string> {
+		switch (strtolower($group)) {
+			case 'replication':
+				return Map<string, ?string> {'SHOW SLAVE STATUS' => ''};
+		}
+
+		return Map<string, ?string> {};
+	}
+
+	/**
+	 *  Populate the given information groups, sending the queries of all groups at once
+	 *  @name    _collect
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array   groups
+	 *  @return  void
+	 */
+	protected function _collect(array<string> $groups):void {
+		$pending = Map<string, Map<string, ?string>> {};
+		$queries = Vector<string> {};
+
+		foreach ($groups as $group) {
+			$group = strtolower($group);
+			$query = $this->_getGroupQueries($group);
+
+			if (count($query) && !$pending->contains($group) && !$this->_module->contains(strtoupper($group))) {
+				$pending->set($group, $query);
+				$queries->addAll($query->keys());
+			}
+		}
+
+		if (!count($queries)) {
+			return;
+		}
+
+		$results = $this->call('../pipeline', $queries);
+		$index   = 0;
+		foreach ($pending as $group=>$query) {
+			$instance = parent::register($group);
+
+			foreach ($query as $prefix) {
+				$this->_populate($instance, $results->get($index++), $prefix);
+			}
 		}
+	}
 
-		return $instance;
+	/**
+	 *  Populate an information group with the records of a result
+	 *  @name    _populate
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   object  group instance
+	 *  @param   object  result
+	 *  @param   string  prefix (null to use the name of each record)
+	 *  @return  void
+	 */
+	protected function _populate(object $instance, ?CoreDBMySQLiQuery $result, ?string $prefix):void {
+		if (is_object($result) && $result->errno <= 0 && (bool) $result->rows)
+			while ($record = $result->next()) {
+				//  SHOW VARIABLES/STATUS provide name/value pairs, other statements a record per item
+				if (isset($record->Variable_name)) {
+					$instance->set($prefix . strtolower($record->Variable_name), $record->Value);
+				}
+				else {
+					$base = is_null($prefix) ? $record->Name . '/' : $prefix;
+					foreach ($record as $key=>$value)
+						$instance->set($base . strtolower($key), $value);
+				}
+			}
 	}
 }
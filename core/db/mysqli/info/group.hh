@@ -0,0 +1,273 @@
+<?hh  //  strict
+
+
+/**
+ *  Lazily collected MySQL information group, values are only queried once they are read and kept as values instead of
+ *  (stub) modules
+ *  @name    CoreDBMySQLiInfoGroup
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Cachable groups keep their values in a CoreDBMySQLiCache per server, configured by /Config/MySQLi/info<setting>
+ *           (size, ttl and shared, shared by default so the values are queried once per ttl instead of once per request)
+ */
+class CoreDBMySQLiInfoGroup<Konsolidate> extends Konsolidate {
+	/**
+	 *  The caches by server (shared by all groups)
+	 *  @name    _registry
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, CoreDBMySQLiCache> $_registry;
+
+	/**
+	 *  The values read so far
+	 *  @name    _value
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, mixed> $_value;
+
+	/**
+	 *  Whether or not all values of the group have been read
+	 *  @name    _complete
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_complete;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->_value    = Map<string, mixed> {};
+		$this->_complete = false;
+	}
+
+	/**
+	 *  get a value, querying it if it was not read before
+	 *  @name    get
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string name (or path)
+	 *  @param   mixed  default return value (optional, default null)
+	 *  @returns mixed  value
+	 */
+	public function get():mixed {
+		$arg = func_get_args();
+
+		if (strpos($arg[0], static::MODULE_SEPARATOR) !== false) {
+			return call_user_func_array('parent::get', $arg);
+		}
+
+		$value = $this->read($arg[0]);
+
+		return is_null($value) && count($arg) > 1 ? $arg[1] : $value;
+	}
+
+	/**
+	 *  Read a single value
+	 *  @name    read
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string name
+	 *  @returns mixed  value (null if unknown)
+	 */
+	public function read(string $name):mixed {
+		$name = strtolower($name);
+
+		if (!$this->_value->contains($name) && !$this->_complete) {
+			$this->load(Vector<string> {$name});
+		}
+
+		return $this->_value->get($name);
+	}
+
+	/**
+	 *  Load the given values (all values if none are given) at once
+	 *  @name    load
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable names (optional, default all)
+	 *  @returns Map  values
+	 */
+	public function load(?Traversable<string> $name=null):Map<string, mixed> {
+		if (is_null($name)) {
+			if (!$this->_complete) {
+				$this->_value->setAll($this->_fetch(null));
+				$this->_complete = true;
+			}
+
+			return $this->_value;
+		}
+
+		$missing = Vector<string> {};
+		$result  = Map<string, mixed> {};
+		foreach ($name as $item) {
+			$item = strtolower($item);
+			$result->set($item, null);
+
+			if (!$this->_value->contains($item) && !$this->_complete) {
+				$missing->add($item);
+			}
+		}
+
+		if (count($missing)) {
+			$fetched = $this->_fetch($missing);
+
+			//  unknown names are remembered as well, so they are not queried again
+			foreach ($missing as $item) {
+				$this->_value->set($item, $fetched->get($item));
+			}
+		}
+
+		foreach ($result as $item=>$value) {
+			$result->set($item, $this->_value->get($item));
+		}
+
+		return $result;
+	}
+
+	public function __get(string $property):mixed {
+		return $property === 'modules' ? parent::__get($property) : $this->get($property);
+	}
+
+	/**
+	 *  Obtain the given values (or all values) from the cache, querying those which are not cached
+	 *  @name    _fetch
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Vector names (null for all)
+	 *  @returns Map    values
+	 */
+	protected function _fetch(?Vector<string> $name):Map<string, mixed> {
+		$cache = $this->_isCachable() ? $this->_getCache() : null;
+
+		if (is_null($name)) {
+			$value = $cache ? $cache->fetch($this->_getKey('*')) : null;
+
+			if (!($value instanceof Map)) {
+				$value = $this->_query(null);
+
+				if ($cache && count($value)) {
+					$cache->store($this->_getKey('*'), $value);
+				}
+			}
+
+			return $value;
+		}
+
+		$result  = Map<string, mixed> {};
+		$missing = Vector<string> {};
+		foreach ($name as $item) {
+			$value = $cache ? $cache->fetch($this->_getKey($item)) : null;
+
+			if (is_null($value)) {
+				$missing->add($item);
+			}
+			else {
+				$result->set($item, $value);
+			}
+		}
+
+		if (count($missing)) {
+			$fetched = $this->_query($missing);
+
+			foreach ($missing as $item) {
+				if ($fetched->contains($item)) {
+					$result->set($item, $fetched->get($item));
+
+					if ($cache) {
+						$cache->store($this->_getKey($item), $fetched->get($item));
+					}
+				}
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Query the given values (or all values)
+	 *  @name    _query
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Vector names (null for all)
+	 *  @returns Map    values by (lowercase) name
+	 */
+	protected function _query(?Vector<string> $name):Map<string, mixed> {
+		return Map<string, mixed> {};
+	}
+
+	/**
+	 *  Create the name condition for SHOW statements
+	 *  @name    _createCondition
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string column
+	 *  @param   Vector names (null for all)
+	 *  @returns string condition (empty for all)
+	 */
+	protected function _createCondition(string $column, ?Vector<string> $name):string {
+		if (is_null($name)) {
+			return '';
+		}
+
+		$quoted = Array();
+		foreach ($name as $item) {
+			$quoted[] = $this->call('../../quote', $item);
+		}
+
+		return ' WHERE ' . $column . ' IN (' . implode(',', $quoted) . ')';
+	}
+
+	/**
+	 *  Whether or not the values may be cached (and shared between requests)
+	 *  @name    _isCachable
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns bool   cachable
+	 */
+	protected function _isCachable():bool {
+		return true;
+	}
+
+	/**
+	 *  Create the cache key for a value
+	 *  @name    _getKey
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string name ('*' for all values)
+	 *  @returns string key
+	 */
+	protected function _getKey(string $name):string {
+		return get_class($this) . ':' . $name;
+	}
+
+	/**
+	 *  Obtain the cache of the server
+	 *  @name    _getCache
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns CoreDBMySQLiCache cache
+	 */
+	protected function _getCache():CoreDBMySQLiCache {
+		$server = $this->call('../../server');
+
+		if (!static::$_registry) {
+			static::$_registry = Map<string, CoreDBMySQLiCache> {};
+		}
+		if (!static::$_registry->contains($server)) {
+			static::$_registry->set($server, $this->instance('../../Cache', 'info:' . $server, '/Config/MySQLi/info', true));
+		}
+
+		return static::$_registry->get($server);
+	}
+}
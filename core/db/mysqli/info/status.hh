@@ -0,0 +1,104 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQL server status, only the status variables which are read are queried
+ *  @name    CoreDBMySQLiInfoStatus
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Status values are read in the global scope, the Global and Session modules (e.g. Status/Session/Bytes_sent)
+ *           are scoped instances. As the values change all the time, they are never cached
+ */
+class CoreDBMySQLiInfoStatus<CoreDBMySQLiInfoGroup> extends CoreDBMySQLiInfoGroup {
+	/**
+	 *  The scope (GLOBAL or SESSION)
+	 *  @name    _scope
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_scope;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @param   string scope (optional, default null, the global scope which also provides the scoped modules)
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent, ?string $scope=null) {
+		parent::__construct($parent);
+
+		$this->_scope = $scope ? strtoupper($scope) : '';
+	}
+
+	/**
+	 *  Load the given values (all values if none are given) at once
+	 *  @name    load
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable names (optional, default all)
+	 *  @returns Map  values
+	 *  @note    loading all values of the global scope also loads all values of the session scope
+	 */
+	public function load(?Traversable<string> $name=null):Map<string, mixed> {
+		if (is_null($name) && !$this->_scope) {
+			$this->register('Session')->load();
+		}
+
+		return parent::load($name);
+	}
+
+	/**
+	 *  Register the scoped (Global or Session) status modules
+	 *  @name    register
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string module
+	 *  @returns Object
+	 *  @note    this method is an override to Konsolidates default behaviour
+	 */
+	public function register(string $module):object {
+		$scope = strtoupper($module);
+
+		if (!$this->_scope && in_array($scope, Array('GLOBAL', 'SESSION')) && !$this->_module->contains($scope)) {
+			$this->_module->set($scope, $this->instance('../Status', $scope));
+		}
+
+		return parent::register($module);
+	}
+
+	/**
+	 *  Query the given status variables (or all status variables)
+	 *  @name    _query
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Vector names (null for all)
+	 *  @returns Map    values by (lowercase) name
+	 */
+	protected function _query(?Vector<string> $name):Map<string, mixed> {
+		$value  = Map<string, mixed> {};
+		$result = $this->call('../../query', 'SHOW ' . ($this->_scope ?: 'GLOBAL') . ' STATUS' . $this->_createCondition('Variable_name', $name), false);
+
+		if (is_object($result) && $result->errno <= 0) {
+			while ($record = $result->next()) {
+				$value->set(strtolower($record->Variable_name), $record->Value);
+			}
+		}
+
+		return $value;
+	}
+
+	/**
+	 *  Whether or not the values may be cached (and shared between requests)
+	 *  @name    _isCachable
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns bool   cachable
+	 */
+	protected function _isCachable():bool {
+		return false;
+	}
+}
@@ -0,0 +1,146 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQL table status, only the status of the tables which are read is queried
+ *  @name    CoreDBMySQLiInfoTable
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Every table is a module (e.g. Table/user/rows) holding the (lowercase) columns of SHOW TABLE STATUS
+ */
+class CoreDBMySQLiInfoTable<CoreDBMySQLiInfoGroup> extends CoreDBMySQLiInfoGroup {
+	/**
+	 *  The table (empty for the module providing the tables)
+	 *  @name    _table
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_table;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @param   string table (optional, default none)
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent, string $table='') {
+		parent::__construct($parent);
+
+		$this->_table = $table;
+	}
+
+	/**
+	 *  Read a single value (or table)
+	 *  @name    read
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string name
+	 *  @returns mixed  value (the table module if no table is set)
+	 *  @note    SHOW TABLE STATUS can only provide all columns of a table, which are read at once
+	 */
+	public function read(string $name):mixed {
+		if (!$this->_table) {
+			return $this->register($name);
+		}
+
+		return $this->load()->get(strtolower($name));
+	}
+
+	/**
+	 *  Load all values (of all tables if no table is set) at once
+	 *  @name    load
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable names (ignored, the status of a table is always loaded completely)
+	 *  @returns Map  values
+	 */
+	public function load(?Traversable<string> $name=null):Map<string, mixed> {
+		if ($this->_table || $this->_complete) {
+			return parent::load(null);
+		}
+
+		foreach ($this->_fetch(null) as $table=>$value) {
+			$this->register($table)->_prime($value);
+		}
+		$this->_complete = true;
+
+		return $this->_value;
+	}
+
+	/**
+	 *  Register the table modules
+	 *  @name    register
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string module
+	 *  @returns Object
+	 *  @note    this method is an override to Konsolidates default behaviour
+	 */
+	public function register(string $module):object {
+		if (!$this->_table && !$this->_module->contains(strtoupper($module))) {
+			$this->_module->set(strtoupper($module), $this->instance('../Table', $module));
+		}
+
+		return parent::register($module);
+	}
+
+	/**
+	 *  Provide the values of a table obtained by the module providing all tables
+	 *  @name    _prime
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Map    values
+	 *  @returns void
+	 */
+	protected function _prime(Map<string, mixed> $value):void {
+		if (!$this->_complete) {
+			$this->_value->setAll($value);
+			$this->_complete = true;
+		}
+	}
+
+	/**
+	 *  Query the status of the table (or of all tables)
+	 *  @name    _query
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Vector names (ignored)
+	 *  @returns Map    values by (lowercase) column, or (if no table is set) the values by table
+	 */
+	protected function _query(?Vector<string> $name):Map<string, mixed> {
+		$value  = Map<string, mixed> {};
+		$result = $this->call('../../query', 'SHOW TABLE STATUS' . ($this->_table ? $this->_createCondition('Name', Vector<string> {$this->_table}) : ''), false);
+
+		if (is_object($result) && $result->errno <= 0) {
+			while ($record = $result->next()) {
+				$column = Map<string, mixed> {};
+				foreach ($record as $key=>$item) {
+					$column->set(strtolower($key), $item);
+				}
+
+				if ($this->_table) {
+					return $column;
+				}
+				$value->set($record->Name, $column);
+			}
+		}
+
+		return $value;
+	}
+
+	/**
+	 *  Create the cache key for a value
+	 *  @name    _getKey
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string name ('*' for all values)
+	 *  @returns string key
+	 */
+	protected function _getKey(string $name):string {
+		return parent::_getKey($this->call('../../database') . '.' . $this->_table . ':' . $name);
+	}
+}
@@ -0,0 +1,31 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQL server variables, only the variables which are read are queried
+ *  @name    CoreDBMySQLiInfoVariable
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ */
+class CoreDBMySQLiInfoVariable<CoreDBMySQLiInfoGroup> extends CoreDBMySQLiInfoGroup {
+	/**
+	 *  Query the given variables (or all variables)
+	 *  @name    _query
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Vector names (null for all)
+	 *  @returns Map    values by (lowercase) name
+	 */
+	protected function _query(?Vector<string> $name):Map<string, mixed> {
+		$value  = Map<string, mixed> {};
+		$result = $this->call('../../query', 'SHOW VARIABLES' . $this->_createCondition('Variable_name', $name), false);
+
+		if (is_object($result) && $result->errno <= 0) {
+			while ($record = $result->next()) {
+				$value->set(strtolower($record->Variable_name), $record->Value);
+			}
+		}
+
+		return $value;
+	}
+}
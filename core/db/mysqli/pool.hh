@@ -0,0 +1,321 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQLi connection pool, holding the connections to a single DSN
+ *  @name    CoreDBMySQLiPool
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Pools are shared by all CoreDBMySQLi instances using the same DSN (see CoreDBMySQLi::setConnection), the
+ *           settings are read from /Config/MySQLi/pool<setting>: min (default 0), max (default 8), idle (seconds an idle
+ *           connection is kept, default 60), ping (seconds idle before a connection is checked, default 1) and
+ *           persistent (default true). LOAD DATA LOCAL INFILE is enabled by /Config/MySQLi/localinfile, native int and
+ *           float values (instead of strings) by /Config/MySQLi/nativetypes.
+ *           HHVM resets static state on every request, so the pool itself (its idle connections, min/idle/ping
+ *           bookkeeping and metrics) only lives for the duration of a request. Connections survive the request by
+ *           being persistent ('p:'), in which case mysqli keeps them open in the worker and hands them to the pool of
+ *           the next request, saving the TCP and authentication handshake. Disable persistent connections only if the
+ *           server cannot afford a connection per worker.
+ *           With the fake option in the DSN the connections are opened on a fake server (see CoreDBMySQLiFake)
+ */
+class CoreDBMySQLiPool<Konsolidate> extends Konsolidate {
+	/**
+	 *  The connection URI (parsed url)
+	 *  @name    _URI
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_URI;
+
+	/**
+	 *  The idle connections (most recently released last) and the time they were released
+	 *  @name    _idle
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<Pair<MySQLi, float>> $_idle;
+
+	/**
+	 *  The number of connections handed out
+	 *  @name    _busy
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_busy;
+
+	/**
+	 *  The pool settings
+	 *  @name    _setting
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, mixed> $_setting;
+
+	/**
+	 *  The acquire/create/reuse/discard/expire/exhaust counters
+	 *  @name    _metric
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, int> $_metric;
+
+	/**
+	 *  The fake server handing out the connections (null if the DSN has no fake option, see CoreDBMySQLiFake)
+	 *  @name    _fake
+	 *  @type    CoreDBMySQLiFake
+	 *  @access  protected
+	 */
+	protected ?CoreDBMySQLiFake $_fake;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @param   Map    connection URI (parsed url)
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent, Map<string, string> $uri) {
+		parent::__construct($parent);
+
+		$this->_URI     = $uri;
+		$this->_idle    = Vector<Pair<MySQLi, float>> {};
+		$this->_busy    = 0;
+		$this->_setting = Map<string, mixed> {
+			'min'         => max(0, (int) $this->get('/Config/MySQLi/poolmin', 0)),
+			'max'         => max(1, (int) $this->get('/Config/MySQLi/poolmax', 8)),
+			'idle'        => (float) $this->get('/Config/MySQLi/poolidle', 60),
+			'ping'        => (float) $this->get('/Config/MySQLi/poolping', 1),
+			'persistent'  => (bool) $this->get('/Config/MySQLi/poolpersistent', true),
+			'localinfile' => (bool) $this->get('/Config/MySQLi/localinfile', false),
+			'nativetypes' => (bool) $this->get('/Config/MySQLi/nativetypes', false)
+		};
+		$this->_metric  = Map<string, int> {
+			'acquire' => 0,
+			'create'  => 0,
+			'reuse'   => 0,
+			'discard' => 0,
+			'expire'  => 0,
+			'exhaust' => 0,
+			'peak'    => 0
+		};
+
+		$option = Array();
+		parse_str($uri->get('query') ?: '', $option);
+		$this->_fake = array_key_exists('fake', $option) ? $this->instance('../Fake', Map::fromArray($option)) : null;
+	}
+
+	/**
+	 *  Open connections until the configured minimum number of connections is available
+	 *  @name    warm
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int    number of connections
+	 *  @note    Called by CoreDBMySQLi::connect, with persistent connections this picks up the connections kept open by
+	 *           the worker instead of opening new ones
+	 */
+	public function warm():int {
+		while ($this->size() < $this->_setting['min']) {
+			$this->_idle->add(Pair {$this->_open(), microtime(true)});
+		}
+
+		return $this->size();
+	}
+
+	/**
+	 *  Obtain a connection, reusing a healthy idle connection if available
+	 *  @name    acquire
+	 *  @type    method
+	 *  @access  public
+	 *  @returns MySQLi connection (null if the maximum number of connections is in use)
+	 *  @throws  Exception if a new connection could not be established
+	 */
+	public function acquire():?MySQLi {
+		$connection = null;
+
+		while (!$connection && count($this->_idle)) {
+			list($candidate, $released) = $this->_idle->pop();
+			$idle = microtime(true) - $released;
+
+			if ($idle > $this->_setting['idle'] && $this->size() >= $this->_setting['min']) {
+				$this->_close($candidate);
+				$this->_metric['expire']++;
+			}
+			//  only verify connections which have been idle for a while, a ping is a roundtrip
+			else if ($idle > $this->_setting['ping'] && !@$candidate->ping()) {
+				$this->_close($candidate);
+				$this->_metric['discard']++;
+			}
+			else {
+				$connection = $candidate;
+				$this->_metric['reuse']++;
+			}
+		}
+
+		if (!$connection) {
+			if ($this->size() >= $this->_setting['max']) {
+				$this->_metric['exhaust']++;
+
+				return null;
+			}
+
+			$connection = $this->_open();
+		}
+
+		++$this->_busy;
+		$this->_metric['acquire']++;
+		$this->_metric['peak'] = max($this->_metric['peak'], $this->_busy);
+
+		return $connection;
+	}
+
+	/**
+	 *  Return a connection to the pool, resetting its session state
+	 *  @name    release
+	 *  @type    method
+	 *  @access  public
+	 *  @param   MySQLi connection
+	 *  @returns void
+	 *  @note    Any open transaction is rolled back and autocommit is enabled, connections which fail to reset are
+	 *           closed instead of being reused
+	 */
+	public function release(MySQLi $connection):void {
+		--$this->_busy;
+
+		if (@$connection->rollback() && @$connection->autocommit(true)) {
+			$this->_idle->add(Pair {$connection, microtime(true)});
+		}
+		else {
+			$this->_close($connection);
+			$this->_metric['discard']++;
+		}
+	}
+
+	/**
+	 *  Close a connection handed out by acquire instead of returning it to the pool
+	 *  @name    discard
+	 *  @type    method
+	 *  @access  public
+	 *  @param   MySQLi connection
+	 *  @returns void
+	 */
+	public function discard(MySQLi $connection):void {
+		--$this->_busy;
+		$this->_close($connection);
+		$this->_metric['discard']++;
+	}
+
+	/**
+	 *  Close all idle connections
+	 *  @name    close
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function close():void {
+		foreach ($this->_idle as $idle) {
+			$this->_close($idle[0]);
+		}
+		$this->_idle->clear();
+	}
+
+	/**
+	 *  Obtain the number of connections (both idle and handed out)
+	 *  @name    size
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int size
+	 */
+	public function size():int {
+		return count($this->_idle) + $this->_busy;
+	}
+
+	/**
+	 *  Obtain the pool metrics
+	 *  @name    metrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function metrics():Map<string, mixed> {
+		$result = Map<string, mixed> {};
+		$result->setAll($this->_metric);
+		$result->set('size', $this->size());
+		$result->set('idle', count($this->_idle));
+		$result->set('busy', $this->_busy);
+		$result->set('max', $this->_setting['max']);
+		$result->set('utilisation', $this->_busy / $this->_setting['max']);
+
+		return $result;
+	}
+
+	/**
+	 *  Obtain the fake server handing out the connections
+	 *  @name    fake
+	 *  @type    method
+	 *  @access  public
+	 *  @returns CoreDBMySQLiFake fake server (null if the connections are not fake)
+	 */
+	public function fake():?CoreDBMySQLiFake {
+		return $this->_fake;
+	}
+
+	/**
+	 *  Open a new connection
+	 *  @name    _open
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns MySQLi connection
+	 *  @throws  Exception if the connection could not be established
+	 */
+	protected function _open():MySQLi {
+		if ($this->_fake) {
+			$this->_metric['create']++;
+
+			return $this->_fake->open();
+		}
+
+		$connection = mysqli_init();
+
+		//  LOAD DATA LOCAL INFILE (see CoreDBMySQLiBatch) must be allowed before connecting
+		if ($this->_setting['localinfile']) {
+			$connection->options(MYSQLI_OPT_LOCAL_INFILE, true);
+		}
+
+		//  only available with mysqlnd, without it CoreDBMySQLiQuery::setTyped converts the values instead
+		if ($this->_setting['nativetypes'] && defined('MYSQLI_OPT_INT_AND_FLOAT_NATIVE')) {
+			$connection->options(MYSQLI_OPT_INT_AND_FLOAT_NATIVE, true);
+		}
+
+		//  the 'p:' prefix lets mysqli reuse a connection left open by a previous request
+		@$connection->real_connect(
+			($this->_setting['persistent'] ? 'p:' : '') . $this->_URI->get('host'),
+			$this->_URI->get('user'),
+			$this->_URI->get('pass') ?: '',
+			trim($this->_URI->get('path'), '/'),
+			$this->_URI->get('port') ?: 3306
+		);
+
+		if ($connection->connect_error) {
+			$this->exception($connection->connect_error, $connection->connect_errno);
+		}
+
+		$this->_metric['create']++;
+
+		return $connection;
+	}
+
+	/**
+	 *  Close a connection
+	 *  @name    _close
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   MySQLi connection
+	 *  @returns void
+	 */
+	protected function _close(MySQLi $connection):void {
+		@$connection->close();
+	}
+}
@@ -0,0 +1,360 @@
+<?hh  //  strict
+
+
+/**
+ *  Query profiler, aggregating the executed queries by fingerprint for the current request and (if APC is available)
+ *  for the process as a whole
+ *  @name    CoreDBMySQLiProfiler
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    The profiler is enabled by /Config/MySQLi/profile. Queries slower than /Config/MySQLi/profileslow
+ *           milliseconds (default 1000) are logged right away, reading queries executed /Config/MySQLi/profilerepeat
+ *           times (default 10) within a single request are flagged as repeated (N+1)
+ */
+class CoreDBMySQLiProfiler<Konsolidate> extends Konsolidate {
+	/**
+	 *  The statistics of the current request by fingerprint (shared by all connections)
+	 *  @name    _request
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, Map<string, mixed>> $_request;
+
+	/**
+	 *  Whether the request statistics will be added to the process statistics at the end of the request
+	 *  @name    _persisting
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	static protected bool $_persisting = false;
+
+	/**
+	 *  Whether or not profiling is enabled
+	 *  @name    enabled
+	 *  @type    bool
+	 *  @access  public
+	 */
+	public bool $enabled;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->enabled = (bool) $this->get('/Config/MySQLi/profile', false);
+
+		if (!static::$_request) {
+			static::$_request = Map<string, Map<string, mixed>> {};
+		}
+
+		if ($this->enabled && !static::$_persisting && function_exists('apc_fetch')) {
+			static::$_persisting = true;
+			register_shutdown_function(Array($this, 'persist'));
+		}
+	}
+
+	/**
+	 *  Record an executed query
+	 *  @name    record
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @param   float  duration in seconds
+	 *  @param   int    rows
+	 *  @param   bool   served from cache
+	 *  @param   int    error number
+	 *  @returns void
+	 */
+	public function record(string $query, float $duration, int $rows, bool $cached=false, int $errno=0):void {
+		if (!$this->enabled) {
+			return;
+		}
+
+		$fingerprint = $this->call('../fingerprint', $query, false);
+		$key         = md5($fingerprint);
+
+		if (!static::$_request->contains($key)) {
+			static::$_request->set($key, $this->_createEntry($fingerprint, $query));
+		}
+
+		$entry = static::$_request->get($key);
+		$this->_add($entry, $duration, $rows, $cached, $errno);
+
+		if ($duration * 1000 > (float) $this->get('/Config/MySQLi/profileslow', 1000)) {
+			$this->call('/Log/write', sprintf('%s slow query (%.1f ms, %d rows): %s', get_class($this), $duration * 1000, $rows, $query), 3);
+		}
+	}
+
+	/**
+	 *  Obtain the statistics of the current request, most time consuming first
+	 *  @name    request
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Vector statistics
+	 */
+	public function request():Vector<Map<string, mixed>> {
+		return $this->_summarize(static::$_request, true);
+	}
+
+	/**
+	 *  Obtain the statistics of the process, most time consuming first
+	 *  @name    process
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Vector statistics (empty if APC is not available)
+	 */
+	public function process():Vector<Map<string, mixed>> {
+		$stored = function_exists('apc_fetch') ? apc_fetch($this->_sharedKey()) : false;
+
+		return $this->_summarize($stored instanceof Map ? $stored : Map<string, Map<string, mixed>> {}, false);
+	}
+
+	/**
+	 *  Obtain the repeated (N+1) queries of the current request
+	 *  @name    repeated
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Vector statistics
+	 */
+	public function repeated():Vector<Map<string, mixed>> {
+		$result = Vector<Map<string, mixed>> {};
+		foreach ($this->request() as $entry) {
+			if ($entry->get('repeated')) {
+				$result->add($entry);
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Create a report of the current request (or process) statistics
+	 *  @name    report
+	 *  @type    method
+	 *  @access  public
+	 *  @param   bool   process statistics instead of request statistics (optional, default false)
+	 *  @returns string report
+	 */
+	public function report(bool $process=false):string {
+		$report = Array();
+		foreach ($process ? $this->process() : $this->request() as $entry) {
+			$report[] = sprintf(
+				'%6dx %9.1f ms total %7.1f ms min %7.1f ms max %7.1f ms p95 %8d rows %5d cached%s  %s',
+				$entry->get('count'),
+				$entry->get('total') * 1000,
+				$entry->get('min') * 1000,
+				$entry->get('max') * 1000,
+				$entry->get('p95') * 1000,
+				$entry->get('rows'),
+				$entry->get('cached'),
+				$entry->get('repeated') ? ' N+1' : '',
+				$entry->get('fingerprint')
+			);
+		}
+
+		return implode(PHP_EOL, $report);
+	}
+
+	/**
+	 *  Write the report of the current request to the log
+	 *  @name    log
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    log level (optional, default 4)
+	 *  @returns void
+	 */
+	public function log(int $level=4):void {
+		if (count(static::$_request)) {
+			$this->call('/Log/write', get_class($this) . ' query profile' . PHP_EOL . $this->report(), $level);
+		}
+	}
+
+	/**
+	 *  Export the current request (or process) statistics as JSON (e.g. for a debug panel)
+	 *  @name    export
+	 *  @type    method
+	 *  @access  public
+	 *  @param   bool   process statistics instead of request statistics (optional, default false)
+	 *  @returns string JSON
+	 */
+	public function export(bool $process=false):string {
+		$result = Array();
+		foreach ($process ? $this->process() : $this->request() as $entry) {
+			$result[] = $entry->toArray();
+		}
+
+		return json_encode($result);
+	}
+
+	/**
+	 *  Add the statistics of the current request to the process statistics
+	 *  @name    persist
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 *  @note    Called automatically at the end of the request, concurrent requests may overwrite each others
+	 *           statistics, which is acceptable for profiling purposes
+	 */
+	public function persist():void {
+		if (!count(static::$_request) || !function_exists('apc_fetch')) {
+			return;
+		}
+
+		$stored = apc_fetch($this->_sharedKey());
+		$stored = $stored instanceof Map ? $stored : Map<string, Map<string, mixed>> {};
+
+		foreach (static::$_request as $key=>$entry) {
+			if (!$stored->contains($key)) {
+				$stored->set($key, $this->_createEntry($entry->get('fingerprint'), $entry->get('query')));
+			}
+
+			$target = $stored->get($key);
+			foreach (Array('count', 'total', 'rows', 'cached', 'errors') as $field) {
+				$target->set($field, $target->get($field) + $entry->get($field));
+			}
+			$target->set('min', min($target->get('min'), $entry->get('min')));
+			$target->set('max', max($target->get('max'), $entry->get('max')));
+
+			foreach ($entry->get('sample') as $duration) {
+				$this->_sample($target, $duration);
+			}
+		}
+
+		apc_store($this->_sharedKey(), $stored);
+		static::$_request->clear();
+	}
+
+	/**
+	 *  Create an empty statistics entry
+	 *  @name    _createEntry
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string fingerprint
+	 *  @param   string query (the first occurrence, as example)
+	 *  @returns Map    entry
+	 */
+	protected function _createEntry(string $fingerprint, string $query):Map<string, mixed> {
+		return Map<string, mixed> {
+			'fingerprint' => $fingerprint,
+			'query'       => $query,
+			'count'       => 0,
+			'total'       => 0.0,
+			'min'         => PHP_INT_MAX,
+			'max'         => 0.0,
+			'rows'        => 0,
+			'cached'      => 0,
+			'errors'      => 0,
+			'seen'        => 0,
+			'sample'      => Vector<float> {}
+		};
+	}
+
+	/**
+	 *  Add an execution to a statistics entry
+	 *  @name    _add
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Map    entry
+	 *  @param   float  duration
+	 *  @param   int    rows
+	 *  @param   bool   cached
+	 *  @param   int    error number
+	 *  @returns void
+	 */
+	protected function _add(Map<string, mixed> $entry, float $duration, int $rows, bool $cached, int $errno):void {
+		$entry->set('count', $entry->get('count') + 1);
+		$entry->set('total', $entry->get('total') + $duration);
+		$entry->set('min', min($entry->get('min'), $duration));
+		$entry->set('max', max($entry->get('max'), $duration));
+		$entry->set('rows', $entry->get('rows') + max(0, $rows));
+		$entry->set('cached', $entry->get('cached') + (int) $cached);
+		$entry->set('errors', $entry->get('errors') + (int) ($errno > 0));
+
+		$this->_sample($entry, $duration);
+	}
+
+	/**
+	 *  Keep a sample of the durations (reservoir sampling) to determine the percentiles
+	 *  @name    _sample
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Map    entry
+	 *  @param   float  duration
+	 *  @returns void
+	 */
+	protected function _sample(Map<string, mixed> $entry, float $duration):void {
+		$sample = $entry->get('sample');
+		$limit  = max(1, (int) $this->get('/Config/MySQLi/profilesamples', 1000));
+		$seen   = $entry->get('seen') + 1;
+		$entry->set('seen', $seen);
+
+		if (count($sample) < $limit) {
+			$sample->add($duration);
+		}
+		else if (($index = mt_rand(0, $seen - 1)) < $limit) {
+			$sample->set($index, $duration);
+		}
+	}
+
+	/**
+	 *  Create the summaries (without samples, with the p95 and repeated flag), most time consuming first
+	 *  @name    _summarize
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Map    entries
+	 *  @param   bool   determine repeated (N+1) queries
+	 *  @returns Vector summaries
+	 */
+	protected function _summarize(Map<string, Map<string, mixed>> $entries, bool $repeated):Vector<Map<string, mixed>> {
+		$threshold = max(2, (int) $this->get('/Config/MySQLi/profilerepeat', 10));
+		$result    = Array();
+
+		foreach ($entries as $entry) {
+			$summary = new Map($entry);
+			$sample  = $entry->get('sample')->toArray();
+			sort($sample);
+
+			$summary->remove('sample');
+			$summary->remove('seen');
+			$summary->set('p95', count($sample) ? $sample[(int) ceil(count($sample) * 0.95) - 1] : 0);
+			$summary->set('repeated', $repeated && $entry->get('count') >= $threshold && (bool) preg_match('/^\s*SELECT\b/i', $entry->get('fingerprint')));
+
+			$result[] = $summary;
+		}
+
+		usort($result, Array($this, '_compareTotal'));
+
+		return new Vector($result);
+	}
+
+	/**
+	 *  Compare two summaries by total duration (descending)
+	 *  @name    _compareTotal
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   Map    summary a
+	 *  @param   Map    summary b
+	 *  @returns int    order
+	 */
+	protected function _compareTotal(Map<string, mixed> $a, Map<string, mixed> $b):int {
+		return $b->get('total') <=> $a->get('total');
+	}
+
+	/**
+	 *  Obtain the APC key for the process statistics
+	 *  @name    _sharedKey
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns string key
+	 */
+	protected function _sharedKey():string {
+		return __CLASS__ . ':process';
+	}
+}
@@ -9,6 +9,12 @@
  *  @author  Rogier Spieker <rogier@konsolidate.nl>
  */
 class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
+	const FETCH_OBJECT   = 1;
+	const FETCH_ASSOC    = 2;
+	const FETCH_NUM      = 3;
+	const FETCH_CLASS    = 4;
+	const FETCH_CALLBACK = 5;
+
 	/**
 	 *  The connection resource
 	 *  @name    _conn
@@ -57,6 +63,110 @@ class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
 	 */
 	public int $errno;
 
+	/**
+	 *  Materialised result rows (used for results which are not backed by a MySQLi_Result)
+	 *  @name    _records
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected ?array<stdClass> $_records;
+
+	/**
+	 *  The position in the materialised result rows
+	 *  @name    _pointer
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_pointer = 0;
+
+	/**
+	 *  The packed (compressed, possibly spilled to disk) cached result rows, decoded one chunk at a time
+	 *  @name    _packed
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected ?array $_packed;
+
+	/**
+	 *  The cache which packed the result rows
+	 *  @name    _source
+	 *  @type    CoreDBMySQLiCache
+	 *  @access  protected
+	 */
+	protected ?CoreDBMySQLiCache $_source;
+
+	/**
+	 *  The chunk of the packed result rows currently held in _records
+	 *  @name    _chunk
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_chunk = -1;
+
+	/**
+	 *  Whether or not the resultset is unbuffered (streamed from the server as it is being read)
+	 *  @name    _unbuffered
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_unbuffered = false;
+
+	/**
+	 *  The time at which an asynchronous query was sent
+	 *  @name    _start
+	 *  @type    float
+	 *  @access  protected
+	 */
+	protected float $_start = 0.0;
+
+	/**
+	 *  Whether or not the query was cancelled as it exceeded its timeout
+	 *  @name    _expired
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_expired = false;
+
+	/**
+	 *  The fetch mode (one of the FETCH_* constants)
+	 *  @name    _fetch
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_fetch = self::FETCH_OBJECT;
+
+	/**
+	 *  The class name (FETCH_CLASS) or callable (FETCH_CALLBACK) the rows are hydrated into
+	 *  @name    _shape
+	 *  @type    mixed
+	 *  @access  protected
+	 */
+	protected mixed $_shape;
+
+	/**
+	 *  Whether or not numeric columns are converted to int/float
+	 *  @name    _typed
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_typed = false;
+
+	/**
+	 *  The columns of the result and their type (MYSQLI_TYPE_* constants), determined on first use
+	 *  @name    _field
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected ?array<string, int> $_field;
+
+	/**
+	 *  The columns of the result by position (unique name and type), determined on first use
+	 *  @name    _column
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected ?array<Pair<string, int>> $_column;
+
 	/**
 	 *  execute given query on given connection
 	 *  @name    execute
@@ -64,31 +174,204 @@ class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
 	 *  @access  public
 	 *  @param   string   query
 	 *  @param   MySQLi connection
+	 *  @param   int      result mode (optional, default MYSQLI_STORE_RESULT, use MYSQLI_USE_RESULT to stream)
 	 *  @returns void
+	 *  @note    An unbuffered (MYSQLI_USE_RESULT) resultset must be read completely before the connection can be
+	 *           used for another query, it can only be read once (see stream) and the number of rows is only known
+	 *           once all rows have been read
 	 */
-	public function execute(string $query, MySQLi $connection):void {
+	public function execute(string $query, MySQLi $connection, int $mode=MYSQLI_STORE_RESULT):void {
+		$this->query       = $query;
+		$this->_conn       = $connection;
+		$this->_unbuffered = $mode === MYSQLI_USE_RESULT;
+		$start             = microtime(true);
+		$this->_result     = $this->_conn->query($this->query, $mode);
+
+		$this->_complete($start, $this->_conn);
+	}
+
+	/**
+	 *  send given query on given connection without waiting for the result (MYSQLI_ASYNC)
+	 *  @name    send
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string   query
+	 *  @param   MySQLi connection
+	 *  @returns bool     sent
+	 *  @note    The result must be collected using reap once the connection is reported ready by mysqli_poll
+	 */
+	public function send(string $query, MySQLi $connection):bool {
+		$this->query  = $query;
+		$this->_conn  = $connection;
+		$this->_start = microtime(true);
+
+		return $this->_conn->query($this->query, MYSQLI_ASYNC) !== false;
+	}
+
+	/**
+	 *  mark a query sent using send as cancelled because it exceeded its timeout (before it is collected using reap)
+	 *  @name    expire
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function expire():void {
+		$this->_expired = true;
+	}
+
+	/**
+	 *  collect the result of a query sent using send
+	 *  @name    reap
+	 *  @type    method
+	 *  @access  public
+	 *  @returns void
+	 */
+	public function reap():void {
+		$this->_result = $this->_conn->reap_async_query();
+
+		$this->_complete($this->_start, $this->_conn);
+	}
+
+	/**
+	 *  collect the current result of a multi statement query (see CoreDBMySQLi::pipeline)
+	 *  @name    collect
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string   query (the statement the result belongs to)
+	 *  @param   MySQLi connection
+	 *  @param   float    time at which the statement was started
+	 *  @returns void
+	 */
+	public function collect(string $query, MySQLi $connection, float $start):void {
+		$this->query   = $query;
+		$this->_conn   = $connection;
+		$this->_result = $this->_conn->store_result() ?: $this->_conn->errno === 0;
+
+		$this->_complete($start, $this->_conn);
+	}
+
+	/**
+	 *  mark the query as failed or not executed (e.g. as a previous statement of a multi statement query failed)
+	 *  @name    skip
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string   query
+	 *  @param   string   reason
+	 *  @param   int      error number
+	 *  @returns void
+	 */
+	public function skip(string $query, string $reason, int $errno):void {
 		$this->query    = $query;
-		$this->_conn    = $connection;
+		$this->_result  = false;
+		$this->rows     = 0;
+		$this->duration = 0;
+
+		$this->import('../exception.hh');
+		$this->exception = $this->_createException(new CoreDBMySQLiException($reason, $errno));
+		$this->errno     = &$this->exception->errno;
+		$this->error     = &$this->exception->error;
+	}
+
+	/**
+	 *  execute given prepared statement with given parameters
+	 *  @name    executeStatement
+	 *  @type    method
+	 *  @access  public
+	 *  @param   CoreDBMySQLiStatement statement
+	 *  @param   array    parameters
+	 *  @param   string   types (optional, default determined by the parameter types)
+	 *  @returns void
+	 */
+	public function executeStatement(CoreDBMySQLiStatement $statement, array $param=Array(), ?string $types=null):void {
+		$this->query    = $statement->query;
+		$this->_conn    = $statement->connection();
 		$start          = microtime(true);
-		$this->_result  = $this->_conn->query($this->query);
-		$this->duration = microtime(true) - $start;
+		$result         = $statement->execute($param, $types);
 
-		if ($this->_result instanceof MySQLi_Result) {
-			$this->rows = $this->_result->num_rows;
+		//  statements without mysqlnd (get_result) deliver their rows materialised
+		if (is_array($result)) {
+			$this->_records = $result;
+			$this->_result  = null;
 		}
-		else if ($this->_result === true) {
-			$this->rows = $this->_conn->affected_rows;
+		else {
+			$this->_result = $result;
 		}
 
-		//  We want the exception object to tell us everything is going extremely well, don't throw it!
-		$this->import('../exception.hh');
-		$this->exception = new CoreDBMySQLiException($this->_conn);
-		$this->errno     = &$this->exception->errno;
-		$this->error     = &$this->exception->error;
+		$this->_complete($start, $statement->handle());
 
-		if ($this->errno > 0) {
-			$this->call('/Log/write', __METHOD__ . ' failed: (' . $this->errno . ') ' . $this->error . PHP_EOL . '--> ' . $this->query, 2);
+		if (is_array($this->_records)) {
+			$this->rows = count($this->_records);
+		}
+	}
+
+	/**
+	 *  Restore a (cached) materialised result of the given query
+	 *  @name    restore
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string   query
+	 *  @param   array    result rows (or rows packed by the given cache)
+	 *  @param   array    columns and their type (optional, default determined from the rows, untyped)
+	 *  @param   object   cache which packed the rows (optional, default none)
+	 *  @returns void
+	 *  @note    Packed rows are decoded one chunk at a time while iterating, see CoreDBMySQLiCache::pack
+	 */
+	public function restore(string $query, array $records, ?array<string, int> $field=null, ?CoreDBMySQLiCache $source=null):void {
+		$packed = $source && $source->isPacked($records);
+
+		$this->query    = $query;
+		$this->_packed  = $packed ? $source->open($records) : null;
+		$this->_source  = $packed ? $source : null;
+		$this->_chunk   = -1;
+		$this->_records = $packed ? Array() : $records;
+		$this->_field   = $field;
+		$this->_pointer = 0;
+		$this->_result  = null;
+		$this->rows     = $packed ? $records['rows'] : count($records);
+		$this->duration = 0;
+		$this->errno    = 0;
+		$this->error    = '';
+
+		$this->call('../Profiler/record', $this->query, $this->duration, $this->rows, true);
+	}
+
+	/**
+	 *  Fetch all rows into memory and release the resultset
+	 *  @name    materialise
+	 *  @type    method
+	 *  @access  public
+	 *  @returns array result rows
+	 *  @note    The query remains iterable, the rows are served from memory afterwards
+	 */
+	public function materialise():array {
+		if ($this->_packed) {
+			$records = Array();
+			for ($i = 0; $i < count($this->_packed['chunk']); ++$i) {
+				foreach ($this->_source->unpack($this->_packed, $i) as $record) {
+					$records[] = $record;
+				}
+			}
+			$this->_packed  = null;
+			$this->_records = $records;
 		}
+		else if (!is_array($this->_records)) {
+			//  keep the column types, these are lost once the resultset is released
+			$this->_getFields();
+			$this->rewind();
+			$records = Array();
+			while ($record = $this->_fetchRecord()) {
+				$records[] = $record;
+			}
+
+			if ($this->_result instanceof MySQLi_Result) {
+				$this->_result->free();
+			}
+			$this->_result  = null;
+			$this->_records = $records;
+		}
+		$this->_pointer = 0;
+
+		return $this->_records;
 	}
 
 	/**
@@ -99,7 +382,19 @@ class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
 	 *  @returns bool success
 	 */
 	public function rewind():bool {
-		if ($this->_result instanceof MySQLi_Result && $this->_result->num_rows > 0) {
+		if ($this->_packed) {
+			$this->_chunk   = -1;
+			$this->_records = Array();
+			$this->_pointer = 0;
+
+			return $this->rows > 0;
+		}
+		else if (is_array($this->_records)) {
+			$this->_pointer = 0;
+
+			return count($this->_records) > 0;
+		}
+		else if ($this->_result instanceof MySQLi_Result && !$this->_unbuffered && $this->_result->num_rows > 0) {
 			return $this->_result->data_seek(0);
 		}
 
@@ -114,11 +409,167 @@ class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
 	 *  @returns object resultrow
 	 */
 	public function next():mixed {
-		if ($this->_result instanceof MySQLi_Result) {
-			return $this->_result->fetch_object();
+		if ($this->_fetch === self::FETCH_OBJECT && !$this->_typed) {
+			return $this->_fetchRecord();
 		}
 
-		return false;
+		$row = $this->_fetchRow($this->_fetch !== self::FETCH_NUM);
+
+		return is_array($row) ? $this->_hydrate($row) : $row;
+	}
+
+	/**
+	 *  set the format in which next, stream and fetchAll return the resultrows
+	 *  @name    setFetchMode
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    mode (FETCH_OBJECT, FETCH_ASSOC, FETCH_NUM, FETCH_CLASS or FETCH_CALLBACK)
+	 *  @param   mixed  class name (FETCH_CLASS) or callable receiving the row as associative array (FETCH_CALLBACK)
+	 *  @returns object query
+	 *  @throws  Exception if the mode is unknown or the shape does not fit the mode
+	 *  @note    FETCH_CLASS instances are created without constructor arguments, the columns are assigned as properties
+	 */
+	public function setFetchMode(int $mode, mixed $shape=null):CoreDBMySQLiQuery {
+		if ($mode < self::FETCH_OBJECT || $mode > self::FETCH_CALLBACK) {
+			$this->exception('Unknown fetch mode ' . $mode);
+		}
+		else if ($mode === self::FETCH_CLASS && !(is_string($shape) && class_exists($shape))) {
+			$this->exception('FETCH_CLASS requires an existing class name');
+		}
+		else if ($mode === self::FETCH_CALLBACK && !is_callable($shape)) {
+			$this->exception('FETCH_CALLBACK requires a callable');
+		}
+
+		$this->_fetch = $mode;
+		$this->_shape = $shape;
+
+		return $this;
+	}
+
+	/**
+	 *  convert numeric columns (integer and floating point types) to int and float
+	 *  @name    setTyped
+	 *  @type    method
+	 *  @access  public
+	 *  @param   bool   typed (optional, default true)
+	 *  @returns object query
+	 *  @note    Connections with /Config/MySQLi/nativetypes enabled (MYSQLI_OPT_INT_AND_FLOAT_NATIVE) already deliver
+	 *           native values, DECIMAL columns remain strings to preserve their precision, as do BIGINT UNSIGNED
+	 *           values exceeding PHP_INT_MAX
+	 */
+	public function setTyped(bool $typed=true):CoreDBMySQLiQuery {
+		$this->_typed = $typed;
+
+		return $this;
+	}
+
+	/**
+	 *  Obtain the columns of the result and their type
+	 *  @name    fields
+	 *  @type    method
+	 *  @access  public
+	 *  @returns array  types (MYSQLI_TYPE_* constants) by column name
+	 *  @note    Columns sharing a name (e.g. SELECT a.id, b.id) are reported once, as they are in associative rows,
+	 *           fetchColumns reports them separately
+	 */
+	public function fields():array<string, int> {
+		return $this->_getFields();
+	}
+
+	/**
+	 *  Retrieve the result column oriented, a single Vector of values per column
+	 *  @name    fetchColumns
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map    values by column name
+	 *  @note    Far fewer values are allocated than with fetchAll (no object or array per row), which makes this the
+	 *           preferred way to read large results which are processed per column. Columns sharing a name are
+	 *           suffixed by their occurrence (e.g. SELECT a.id, b.id provides id and id_2)
+	 */
+	public function fetchColumns():Map<string, Vector<mixed>> {
+		$column = Array();
+		foreach ($this->_getColumns() as $index=>$info) {
+			$column[$index] = Vector<mixed> {};
+		}
+
+		if (!$this->_unbuffered) {
+			$this->rewind();
+		}
+
+		while (is_array($row = $this->_fetchRow(false))) {
+			foreach ($column as $index=>$values) {
+				$values->add(array_key_exists($index, $row) ? $row[$index] : null);
+			}
+		}
+		$this->rewind();
+
+		$result = Map<string, Vector<mixed>> {};
+		foreach ($this->_getColumns() as $index=>$info) {
+			$result->set($info[0], $column[$index]);
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Retrieve the values of a single column
+	 *  @name    fetchColumn
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  column name (as provided by fetchColumns) or position (optional, default 0)
+	 *  @returns Vector values
+	 */
+	public function fetchColumn(mixed $column=0):Vector<mixed> {
+		$index  = is_int($column) ? $column : false;
+		$result = Vector<mixed> {};
+
+		if (!is_int($column)) {
+			foreach ($this->_getColumns() as $position=>$info) {
+				if ($info[0] === $column) {
+					$index = $position;
+					break;
+				}
+			}
+		}
+
+		if ($index !== false) {
+			if (!$this->_unbuffered) {
+				$this->rewind();
+			}
+
+			while (is_array($row = $this->_fetchRow(false))) {
+				$result->add(array_key_exists($index, $row) ? $row[$index] : null);
+			}
+			$this->rewind();
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Iterate the resultrows one at a time
+	 *  @name    stream
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Generator resultrows (indexed by position)
+	 *  @note    For unbuffered results only a single row is held in memory, the resultset is released (and the number
+	 *           of rows is known) once the last row has been read
+	 */
+	public function stream():Generator<int, mixed, void> {
+		if (!$this->_unbuffered) {
+			$this->rewind();
+		}
+
+		$index = 0;
+		while ($record = $this->next()) {
+			yield $index++ => $record;
+		}
+
+		if ($this->_unbuffered && $this->_result instanceof MySQLi_Result) {
+			$this->rows    = $index;
+			$this->_result->free();
+			$this->_result = null;
+		}
 	}
 
 	/**
@@ -146,7 +597,7 @@ class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
 	}
 
 	/**
-	 *  Retrieve an array containing all resultrows as objects
+	 *  Retrieve an array containing all resultrows (as objects, unless another fetch mode is set)
 	 *  @name    fetchAll
 	 *  @type    method
 	 *  @access  public
@@ -163,6 +614,267 @@ class CoreDBMySQLiQuery<Konsolidate> extends Konsolidate {
 		return $return;
 	}
 
+	/**
+	 *  Determine the number of rows, error information and duration once the query has been executed
+	 *  @name    _complete
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   float  start time
+	 *  @param   mixed  error source (MySQLi connection or MySQLi_STMT statement)
+	 *  @returns void
+	 */
+	protected function _complete(float $start, mixed $source):void {
+		$this->duration = microtime(true) - $start;
+
+		if ($this->_result instanceof MySQLi_Result) {
+			$this->rows = $this->_result->num_rows;
+		}
+		else if ($this->_result === true || is_array($this->_records)) {
+			$this->rows = $source->affected_rows;
+		}
+
+		//  We want the exception object to tell us everything is going extremely well, don't throw it!
+		$this->import('../exception.hh');
+		$this->exception = $this->_createException(new CoreDBMySQLiException($source));
+		$this->errno     = &$this->exception->errno;
+		$this->error     = &$this->exception->error;
+
+		if ($this->errno > 0) {
+			$this->call('/Log/write', get_class($this) . '::execute failed: (' . $this->errno . ') ' . $this->error . PHP_EOL . '--> ' . $this->query, 2);
+		}
+
+		$this->call('../Profiler/record', $this->query, $this->duration, $this->rows, false, $this->errno);
+	}
+
+	/**
+	 *  get the next result as (unconverted) object
+	 *  @name    _fetchRecord
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns object resultrow (null if there are no more rows, false if there is no resultset)
+	 */
+	protected function _fetchRecord():mixed {
+		$this->_unpack();
+
+		if (is_array($this->_records)) {
+			return $this->_pointer < count($this->_records) ? $this->_records[$this->_pointer++] : null;
+		}
+		else if ($this->_result instanceof MySQLi_Result) {
+			return $this->_result->fetch_object();
+		}
+
+		return false;
+	}
+
+	/**
+	 *  Decode the next chunk of packed result rows once the current chunk has been read
+	 *  @name    _unpack
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns void
+	 */
+	protected function _unpack():void {
+		while ($this->_packed && $this->_pointer >= count($this->_records) && $this->_chunk + 1 < count($this->_packed['chunk'])) {
+			$this->_records = $this->_source->unpack($this->_packed, ++$this->_chunk);
+			$this->_pointer = 0;
+		}
+	}
+
+	/**
+	 *  get the next result as array, converting the numeric columns if the result is typed
+	 *  @name    _fetchRow
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   bool   associative (keyed by column name) instead of numeric
+	 *  @returns array  resultrow (null if there are no more rows, false if there is no resultset)
+	 */
+	protected function _fetchRow(bool $assoc):mixed {
+		$this->_unpack();
+
+		if (is_array($this->_records)) {
+			if ($this->_pointer >= count($this->_records)) {
+				return null;
+			}
+
+			$row = get_object_vars($this->_records[$this->_pointer++]);
+			if (!$assoc) {
+				$row = array_values($row);
+			}
+		}
+		else if ($this->_result instanceof MySQLi_Result) {
+			$row = $assoc ? $this->_result->fetch_assoc() : $this->_result->fetch_row();
+			if (!is_array($row)) {
+				return null;
+			}
+		}
+		else {
+			return false;
+		}
+
+		return $this->_typed ? $this->_cast($row) : $row;
+	}
+
+	/**
+	 *  convert a resultrow into the format of the fetch mode
+	 *  @name    _hydrate
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  resultrow (numeric for FETCH_NUM, associative otherwise)
+	 *  @returns mixed  resultrow
+	 */
+	protected function _hydrate(array $row):mixed {
+		switch ($this->_fetch) {
+			case self::FETCH_ASSOC:
+			case self::FETCH_NUM:
+				return $row;
+
+			case self::FETCH_CLASS:
+				$class  = $this->_shape;
+				$result = new $class();
+				foreach ($row as $name=>$value) {
+					$result->$name = $value;
+				}
+
+				return $result;
+
+			case self::FETCH_CALLBACK:
+				return call_user_func($this->_shape, $row);
+		}
+
+		return (object) $row;
+	}
+
+	/**
+	 *  convert the string values of integer and floating point columns
+	 *  @name    _cast
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  resultrow (in column order)
+	 *  @returns array  resultrow
+	 */
+	protected function _cast(array $row):array {
+		//  associative rows hold a single value per name, numeric rows a value per column
+		$type     = Array();
+		$position = 0;
+		foreach ($this->_getColumns() as $info) {
+			$type[] = $info[1];
+		}
+		if (count($type) !== count($row)) {
+			$type = array_values($this->_getFields());
+		}
+
+		foreach ($row as $key=>$value) {
+			if (is_string($value) && isset($type[$position])) {
+				switch ($type[$position]) {
+					case MYSQLI_TYPE_TINY:
+					case MYSQLI_TYPE_SHORT:
+					case MYSQLI_TYPE_INT24:
+					case MYSQLI_TYPE_LONG:
+					case MYSQLI_TYPE_LONGLONG:
+					case MYSQLI_TYPE_YEAR:
+						//  values which do not fit an int (BIGINT UNSIGNED) remain strings
+						if ((string) (int) $value === $value) {
+							$row[$key] = (int) $value;
+						}
+						break;
+
+					case MYSQLI_TYPE_FLOAT:
+					case MYSQLI_TYPE_DOUBLE:
+						$row[$key] = (float) $value;
+						break;
+				}
+			}
+			++$position;
+		}
+
+		return $row;
+	}
+
+	/**
+	 *  determine the columns of the result and their type
+	 *  @name    _getFields
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns array  types by column name
+	 *  @note    Materialised rows without known types (e.g. prepared statements without mysqlnd) report MYSQLI_TYPE_STRING
+	 *           for every column, their values are never converted
+	 */
+	protected function _getFields():array<string, int> {
+		if (is_null($this->_field)) {
+			$this->_field = Array();
+
+			if ($this->_result instanceof MySQLi_Result) {
+				foreach ($this->_result->fetch_fields() as $field) {
+					$this->_field[$field->name] = $field->type;
+				}
+			}
+			else if (is_array($this->_records) && count($this->_records)) {
+				foreach (get_object_vars($this->_records[0]) as $name=>$value) {
+					$this->_field[$name] = MYSQLI_TYPE_STRING;
+				}
+			}
+		}
+
+		return $this->_field;
+	}
+
+	/**
+	 *  Determine the columns of the result by position, suffixing the names of columns sharing a name
+	 *  @name    _getColumns
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns array  columns (Pair of unique name and type)
+	 */
+	protected function _getColumns():array<Pair<string, int>> {
+		if (is_null($this->_column)) {
+			$this->_column = Array();
+			$column        = Array();
+			$seen          = Array();
+
+			if ($this->_result instanceof MySQLi_Result) {
+				foreach ($this->_result->fetch_fields() as $field) {
+					$column[] = Pair {$field->name, $field->type};
+				}
+			}
+			else {
+				//  materialised rows hold a single value per name
+				foreach ($this->_getFields() as $name=>$type) {
+					$column[] = Pair {$name, $type};
+				}
+			}
+
+			foreach ($column as $info) {
+				$name = $info[0];
+				for ($occurrence = 2; isset($seen[$name]); ++$occurrence) {
+					$name = $info[0] . '_' . $occurrence;
+				}
+				$seen[$name] = true;
+				$this->_column[] = Pair {$name, $info[1]};
+			}
+		}
+
+		return $this->_column;
+	}
+
+	/**
+	 *  Replace the exception object by a CoreDBMySQLiExceptionTimeout if the query exceeded its timeout
+	 *  @name    _createException
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   CoreDBMySQLiException exception
+	 *  @returns CoreDBMySQLiException exception
+	 *  @note    3024 is reported when MAX_EXECUTION_TIME is exceeded, 1317 when the query was cancelled
+	 */
+	protected function _createException(CoreDBMySQLiException $exception):CoreDBMySQLiException {
+		if ($exception->errno === 3024 || ($this->_expired && $exception->errno === 1317)) {
+			$this->import('../exception/timeout.hh');
+
+			return new CoreDBMySQLiExceptionTimeout($exception->error, $exception->errno);
+		}
+
+		return $exception;
+	}
+
 	public function __destruct():void {
 		if (is_resource($this->_result))
 			mysqli_free_result($this->_result);
@@ -0,0 +1,254 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQLi retry policy, deciding whether a failed connection attempt or statement is retried and waiting (jittered
+ *  exponential backoff) before it is
+ *  @name    CoreDBMySQLiRetry
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    The number of attempts per error can be configured using /Config/MySQLi/retry<errno> (e.g. retry1213) or
+ *           /Config/MySQLi/retrypolicy ('errno:attempts,...'). The backoff starts at /Config/MySQLi/retrybase
+ *           milliseconds (default 20) and is capped at /Config/MySQLi/retrymax (default 1000).
+ *           Outside a transaction, modifying statements are not retried after losing the connection, as they may have
+ *           been applied (enable /Config/MySQLi/retrywrites to retry them anyway). Within a transaction, errors which
+ *           roll back the transaction are only retried if /Config/MySQLi/retryreplay is enabled, in which case the
+ *           entire transaction is replayed
+ */
+class CoreDBMySQLiRetry<Konsolidate> extends Konsolidate {
+	/**
+	 *  The number of attempts by error number
+	 *  @name    _policy
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<int, int> $_policy;
+
+	/**
+	 *  The errors after which the connection is lost (and must be reestablished)
+	 *  @name    _connection
+	 *  @type    Set
+	 *  @access  protected
+	 */
+	protected Set<int> $_connection;
+
+	/**
+	 *  The errors which roll back the entire transaction (instead of only the statement)
+	 *  @name    _rollback
+	 *  @type    Set
+	 *  @access  protected
+	 */
+	protected Set<int> $_rollback;
+
+	/**
+	 *  The backoff settings
+	 *  @name    _setting
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, mixed> $_setting;
+
+	/**
+	 *  The retry/recovered/giveup/reconnect/replay/wait counters
+	 *  @name    _metric
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, int> $_metric;
+
+	/**
+	 *  The number of retries by error number
+	 *  @name    _error
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<int, int> $_error;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->_connection = Set<int> {2006, 2013, 2055};
+		$this->_rollback   = Set<int> {1213, 2006, 2013, 2055};
+		$this->_error      = Map<int, int> {};
+		$this->_setting    = Map<string, mixed> {
+			'base'   => max(1, (int) $this->get('/Config/MySQLi/retrybase', 20)),
+			'max'    => max(1, (int) $this->get('/Config/MySQLi/retrymax', 1000)),
+			'writes' => (bool) $this->get('/Config/MySQLi/retrywrites', false),
+			'replay' => (bool) $this->get('/Config/MySQLi/retryreplay', false)
+		};
+		$this->_metric     = Map<string, int> {
+			'retry'     => 0,
+			'recovered' => 0,
+			'giveup'    => 0,
+			'reconnect' => 0,
+			'replay'    => 0,
+			'wait'      => 0
+		};
+
+		//  deadlock, lock wait timeout, server gone away, lost connection, can't connect and too many connections
+		$this->_policy = Map<int, int> {1213 => 3, 1205 => 1, 2006 => 2, 2013 => 2, 2055 => 2, 2002 => 2, 2003 => 2, 1040 => 3};
+		foreach ($this->_policy as $errno=>$attempts) {
+			$this->_policy->set($errno, (int) $this->get('/Config/MySQLi/retry' . $errno, $attempts));
+		}
+		foreach (array_filter(explode(',', (string) $this->get('/Config/MySQLi/retrypolicy', ''))) as $rule) {
+			list($errno, $attempts) = array_pad(explode(':', $rule, 2), 2, 1);
+			$this->setPolicy((int) $errno, (int) $attempts);
+		}
+	}
+
+	/**
+	 *  Set the number of attempts for an error
+	 *  @name    setPolicy
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    error number
+	 *  @param   int    attempts (0 to never retry)
+	 *  @returns void
+	 */
+	public function setPolicy(int $errno, int $attempts):void {
+		$this->_policy->set($errno, max(0, $attempts));
+	}
+
+	/**
+	 *  Decide whether to retry after the given error, waiting before returning if so
+	 *  @name    attempt
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    error number
+	 *  @param   int    attempt (1 for the first retry)
+	 *  @param   bool   modifying statement (optional, default false)
+	 *  @param   bool   within a transaction (optional, default false)
+	 *  @returns bool   retry
+	 */
+	public function attempt(int $errno, int $attempt, bool $modifying=false, bool $transaction=false):bool {
+		$attempts = $this->_policy->get($errno) ?: 0;
+
+		if (!$attempts) {
+			return false;
+		}
+
+		if ($attempt > $attempts || !$this->_isSafe($errno, $modifying, $transaction)) {
+			$this->_metric['giveup']++;
+
+			return false;
+		}
+
+		$wait = $this->backoff($attempt);
+		$this->_metric['retry']++;
+		$this->_metric['wait'] += $wait;
+		$this->_error->set($errno, ($this->_error->get($errno) ?: 0) + 1);
+
+		$this->call('/Log/write', sprintf('%s retrying after error %d (attempt %d of %d, waiting %d ms)', get_class($this), $errno, $attempt, $attempts, $wait), 4);
+		usleep($wait * 1000);
+
+		return true;
+	}
+
+	/**
+	 *  Determine the time to wait before the given attempt
+	 *  @name    backoff
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    attempt (1 for the first retry)
+	 *  @returns int    milliseconds
+	 *  @note    The wait is a random value up to the exponential backoff ('full jitter'), so clients which failed at
+	 *           the same time (e.g. both sides of a deadlock) do not retry at the same time
+	 */
+	public function backoff(int $attempt):int {
+		$limit = min($this->_setting['max'], $this->_setting['base'] * pow(2, max(0, min(30, $attempt - 1))));
+
+		return mt_rand(0, (int) $limit);
+	}
+
+	/**
+	 *  Determine whether the connection is lost after the given error
+	 *  @name    isConnectionError
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    error number
+	 *  @returns bool   lost
+	 */
+	public function isConnectionError(int $errno):bool {
+		return $this->_connection->contains($errno);
+	}
+
+	/**
+	 *  Determine whether the transaction is rolled back after the given error
+	 *  @name    isTransactionLost
+	 *  @type    method
+	 *  @access  public
+	 *  @param   int    error number
+	 *  @returns bool   rolled back
+	 */
+	public function isTransactionLost(int $errno):bool {
+		return $this->_rollback->contains($errno);
+	}
+
+	/**
+	 *  Whether or not transactions are to be replayed
+	 *  @name    replay
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool   replay
+	 */
+	public function replay():bool {
+		return $this->_setting['replay'];
+	}
+
+	/**
+	 *  Count an event (recovered, reconnect or replay)
+	 *  @name    record
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string event
+	 *  @returns void
+	 */
+	public function record(string $event):void {
+		if ($this->_metric->contains($event)) {
+			$this->_metric[$event]++;
+		}
+	}
+
+	/**
+	 *  Obtain the retry metrics
+	 *  @name    metrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function metrics():Map<string, mixed> {
+		$result = Map<string, mixed> {};
+		$result->setAll($this->_metric);
+		$result->set('error', $this->_error->toArray());
+
+		return $result;
+	}
+
+	/**
+	 *  Determine whether retrying after the given error is safe
+	 *  @name    _isSafe
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   int    error number
+	 *  @param   bool   modifying statement
+	 *  @param   bool   within a transaction
+	 *  @returns bool   safe
+	 */
+	protected function _isSafe(int $errno, bool $modifying, bool $transaction):bool {
+		if ($transaction) {
+			return !$this->isTransactionLost($errno) || $this->_setting['replay'];
+		}
+
+		//  a modifying statement may have been applied before the connection was lost
+		return !$modifying || !$this->isConnectionError($errno) || $this->_setting['writes'];
+	}
+}
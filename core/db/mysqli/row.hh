@@ -0,0 +1,375 @@
+<?hh  //  strict
+
+
+/**
+ *  Row cache for primary key lookups of a single table, rows are looked up in the (process local and optionally shared)
+ *  cache before they are queried, writes through this object update or invalidate the cached rows
+ *  @name    CoreDBMySQLiRow
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Rows are cached in a CoreDBMySQLiCache per database, configured by /Config/MySQLi/row<setting> (size, ttl
+ *           and shared, shared by default). /Config/MySQLi/rowwrite determines whether writes 'invalidate' (default)
+ *           or 'update' the cached row. Writes which do not pass through this object are only noticed once the
+ *           cached row expires. Within a transaction rows are not cached and the rows written are invalidated again
+ *           once the transaction is committed
+ */
+class CoreDBMySQLiRow<Konsolidate> extends Konsolidate {
+	/**
+	 *  The caches by database (shared by all tables)
+	 *  @name    _registry
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, CoreDBMySQLiCache> $_registry;
+
+	/**
+	 *  The lookup/hit/miss/query/write counters by table
+	 *  @name    _metric
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, Map<string, int>> $_metric;
+
+	/**
+	 *  The table
+	 *  @name    _table
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_table;
+
+	/**
+	 *  The primary key column
+	 *  @name    _key
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_key;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @param   string table
+	 *  @param   string primary key column (optional, default 'id')
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent, string $table, string $key='id') {
+		parent::__construct($parent);
+
+		$this->_table = $table;
+		$this->_key   = $key;
+
+		if (!static::$_metric) {
+			static::$_metric = Map<string, Map<string, int>> {};
+		}
+		if (!static::$_metric->contains($table)) {
+			static::$_metric->set($table, Map<string, int> {'lookup' => 0, 'hit' => 0, 'miss' => 0, 'query' => 0, 'write' => 0});
+		}
+	}
+
+	/**
+	 *  Obtain a row by its primary key
+	 *  @name    fetch
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  primary key
+	 *  @returns object row (null if the row does not exist)
+	 */
+	public function fetch(mixed $id):?stdClass {
+		return $this->fetchAll(Vector<mixed> {$id})->get((string) $id);
+	}
+
+	/**
+	 *  Obtain rows by their primary keys, querying all uncached rows at once
+	 *  @name    fetchAll
+	 *  @type    method
+	 *  @access  public
+	 *  @param   Traversable primary keys
+	 *  @returns Map rows by primary key (in the order of the keys, rows which do not exist are null)
+	 */
+	public function fetchAll(Traversable<mixed> $ids):Map<string, ?stdClass> {
+		$metric = static::$_metric->get($this->_table);
+		$cache  = $this->_getCache();
+		$result = Map<string, ?stdClass> {};
+		$miss   = Array();
+
+		foreach ($ids as $id) {
+			$id = (string) $id;
+			if ($result->contains($id)) {
+				continue;
+			}
+
+			$metric['lookup']++;
+			$row = $cache->fetch($this->_cacheKey($id));
+
+			//  rows which do not exist are cached as false
+			if (is_null($row)) {
+				$metric['miss']++;
+				$miss[] = $id;
+				$result->set($id, null);
+			}
+			else {
+				$metric['hit']++;
+				$result->set($id, $row ?: null);
+			}
+		}
+
+		if (count($miss)) {
+			$found = $this->_query($miss);
+
+			//  failed queries are not cached, the rows are reported as not existing. Rows read within a transaction
+			//  may not have been committed, so these are not cached either
+			if (is_null($found) || $this->call('../inTransaction')) {
+				if ($found) {
+					foreach ($found as $id=>$row) {
+						$result->set($id, $row);
+					}
+				}
+
+				return $result;
+			}
+
+			foreach ($miss as $id) {
+				$row = $found->contains($id) ? $found->get($id) : null;
+				$result->set($id, $row);
+				$cache->store($this->_cacheKey($id), $row ?: false);
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Insert a row
+	 *  @name    insert
+	 *  @type    method
+	 *  @access  public
+	 *  @param   KeyedTraversable values by column
+	 *  @returns mixed  primary key of the row (null if the insert failed)
+	 */
+	public function insert(KeyedTraversable<string, mixed> $values):mixed {
+		$values = new Map($values);
+		$column = Array();
+		foreach ($values->keys() as $name) {
+			$column[] = $this->_quoteName($name);
+		}
+
+		$result = $this->_write(
+			'INSERT INTO ' . $this->_quoteName($this->_table) . ' (' . implode(',', $column) . ') VALUES (' . implode(',', array_fill(0, count($values), '?')) . ')',
+			$values->values()->toArray()
+		);
+
+		if (!$result) {
+			return null;
+		}
+
+		$id = $values->contains($this->_key) ? $values->get($this->_key) : $result->lastInsertID();
+
+		//  the row may have been cached as not existing
+		$this->_expire($id);
+
+		return $id;
+	}
+
+	/**
+	 *  Update a row
+	 *  @name    update
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed            primary key
+	 *  @param   KeyedTraversable values by column
+	 *  @returns bool   success
+	 *  @note    Cached rows are updated with the values (if configured to do so) outside of transactions, as the
+	 *           transaction may be rolled back
+	 */
+	public function update(mixed $id, KeyedTraversable<string, mixed> $values):bool {
+		$values = new Map($values);
+		$assign = Array();
+		foreach ($values->keys() as $name) {
+			$assign[] = $this->_quoteName($name) . '=?';
+		}
+
+		$param   = $values->values()->toArray();
+		$param[] = $id;
+		$result  = $this->_write('UPDATE ' . $this->_quoteName($this->_table) . ' SET ' . implode(',', $assign) . ' WHERE ' . $this->_quoteName($this->_key) . '=?', $param);
+
+		if (!$result) {
+			return false;
+		}
+
+		$cache = $this->_getCache();
+		$row   = $this->get('/Config/MySQLi/rowwrite', 'invalidate') === 'update' && !$this->call('../inTransaction') && !$values->contains($this->_key) ? $cache->fetch($this->_cacheKey($id)) : null;
+
+		if ($row) {
+			foreach ($values as $name=>$value) {
+				$row->$name = is_null($value) ? null : (string) $value;
+			}
+			$cache->store($this->_cacheKey($id), $row);
+		}
+		else {
+			$this->_expire($id);
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Delete a row
+	 *  @name    delete
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  primary key
+	 *  @returns bool   success
+	 */
+	public function delete(mixed $id):bool {
+		$result = $this->_write('DELETE FROM ' . $this->_quoteName($this->_table) . ' WHERE ' . $this->_quoteName($this->_key) . '=?', Array($id));
+
+		if ($result) {
+			$this->_expire($id);
+		}
+
+		return (bool) $result;
+	}
+
+	/**
+	 *  Remove a row from the cache
+	 *  @name    invalidate
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  primary key
+	 *  @returns void
+	 */
+	public function invalidate(mixed $id):void {
+		$this->_getCache()->remove($this->_cacheKey((string) $id));
+	}
+
+	/**
+	 *  Obtain the row cache metrics of the table (the cache metrics distinguish local and shared hits)
+	 *  @name    metrics
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Map metrics
+	 */
+	public function metrics():Map<string, mixed> {
+		$metric = static::$_metric->get($this->_table);
+		$result = Map<string, mixed> {};
+		$result->setAll($metric);
+		$result->set('ratio', $metric['lookup'] > 0 ? $metric['hit'] / $metric['lookup'] : 0);
+		$result->set('cache', $this->_getCache()->metrics());
+
+		return $result;
+	}
+
+	/**
+	 *  Query the given rows
+	 *  @name    _query
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  primary keys
+	 *  @returns Map    rows by primary key (null if the query failed)
+	 */
+	protected function _query(array $ids):?Map<string, stdClass> {
+		$key    = $this->_key;
+		$found  = Map<string, stdClass> {};
+		$result = $this->call('../execute', 'SELECT * FROM ' . $this->_quoteName($this->_table) . ' WHERE ' . $this->_quoteName($key) . ' IN (' . implode(',', array_fill(0, count($ids), '?')) . ')', $ids);
+
+		static::$_metric->get($this->_table)['query']++;
+
+		if (!is_object($result) || $result->errno !== 0) {
+			return null;
+		}
+
+		while ($row = $result->next()) {
+			$found->set((string) $row->$key, $row);
+		}
+
+		return $found;
+	}
+
+	/**
+	 *  Execute a modifying statement
+	 *  @name    _write
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @param   array  parameters
+	 *  @returns object result (null if the statement failed)
+	 */
+	protected function _write(string $query, array $param):?CoreDBMySQLiQuery {
+		$result = $this->call('../execute', $query, $param);
+
+		static::$_metric->get($this->_table)['write']++;
+
+		return is_object($result) && $result->errno === 0 ? $result : null;
+	}
+
+	/**
+	 *  Invalidate a written row, and again once the transaction is committed (if any) as other requests may cache the
+	 *  previous version of the row in the meantime
+	 *  @name    _expire
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   mixed  primary key
+	 *  @returns void
+	 */
+	protected function _expire(mixed $id):void {
+		$this->invalidate($id);
+
+		if ($this->call('../inTransaction')) {
+			$this->call('../onCommit', Array($this, 'invalidate'), Array($id));
+		}
+	}
+
+	/**
+	 *  Create the cache key of a row
+	 *  @name    _cacheKey
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string primary key
+	 *  @returns string key
+	 */
+	protected function _cacheKey(string $id):string {
+		return $this->_table . ':' . $id;
+	}
+
+	/**
+	 *  Quote a table or column name
+	 *  @name    _quoteName
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string name
+	 *  @returns string quoted name
+	 */
+	protected function _quoteName(string $name):string {
+		$result = Array();
+		foreach (explode('.', $name) as $part) {
+			$result[] = '`' . str_replace('`', '``', $part) . '`';
+		}
+
+		return implode('.', $result);
+	}
+
+	/**
+	 *  Obtain the cache of the database
+	 *  @name    _getCache
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns CoreDBMySQLiCache cache
+	 */
+	protected function _getCache():CoreDBMySQLiCache {
+		$namespace = 'row:' . $this->call('../cacheNamespace');
+
+		if (!static::$_registry) {
+			static::$_registry = Map<string, CoreDBMySQLiCache> {};
+		}
+		if (!static::$_registry->contains($namespace)) {
+			static::$_registry->set($namespace, $this->instance('../Cache', $namespace, '/Config/MySQLi/row', true));
+		}
+
+		return static::$_registry->get($namespace);
+	}
+}
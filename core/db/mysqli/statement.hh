@@ -0,0 +1,217 @@
+<?hh  //  strict
+
+
+/**
+ *  MySQLi prepared statement
+ *  @name    CoreDBMySQLiStatement
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Statements are created (and cached per connection) by CoreDBMySQLi::prepare, use CoreDBMySQLi::execute to
+ *           obtain a CoreDBMySQLiQuery result
+ */
+class CoreDBMySQLiStatement<Konsolidate> extends Konsolidate {
+	/**
+	 *  The query
+	 *  @name    query
+	 *  @type    string
+	 *  @access  public
+	 */
+	public string $query;
+
+	/**
+	 *  The number of times the statement was executed
+	 *  @name    executed
+	 *  @type    int
+	 *  @access  public
+	 */
+	public int $executed;
+
+	/**
+	 *  The connection on which the statement was prepared
+	 *  @name    _conn
+	 *  @type    MySQLi
+	 *  @access  protected
+	 */
+	protected MySQLi $_conn;
+
+	/**
+	 *  The statement handle
+	 *  @name    _statement
+	 *  @type    MySQLi_STMT
+	 *  @access  protected
+	 */
+	protected ?MySQLi_STMT $_statement;
+
+
+	/**
+	 *  Prepare the given query on the given connection
+	 *  @name    prepare
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string   query
+	 *  @param   MySQLi   connection
+	 *  @returns bool     success
+	 *  @note    If the server refuses to prepare the query, the error is logged and left on the connection (errno and
+	 *           error), as query does with errors
+	 */
+	public function prepare(string $query, MySQLi $connection):bool {
+		$this->query      = $query;
+		$this->executed   = 0;
+		$this->_conn      = $connection;
+		$this->_statement = $this->_conn->prepare($this->query);
+
+		if (!$this->_statement) {
+			$this->call('/Log/write', get_class($this) . '::prepare failed: (' . $this->_conn->errno . ') ' . $this->_conn->error . PHP_EOL . '--> ' . $this->query, 2);
+
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Bind the parameters and execute the statement
+	 *  @name    execute
+	 *  @type    method
+	 *  @access  public
+	 *  @param   array    parameters
+	 *  @param   string   types (optional, default determined by the parameter types, see determineTypes)
+	 *  @returns mixed    result (MySQLi_Result, array of rows if mysqlnd is not available, bool for other statements)
+	 */
+	public function execute(array $param=Array(), ?string $types=null):mixed {
+		$this->_statement->reset();
+
+		if (count($param)) {
+			$param = array_values($param);
+			$bind  = Array(is_null($types) ? $this->determineTypes($param) : $types);
+
+			//  bind_param requires references
+			foreach ($param as $index=>$value) {
+				$bind[] = &$param[$index];
+			}
+
+			if (!call_user_func_array(Array($this->_statement, 'bind_param'), $bind)) {
+				return false;
+			}
+		}
+
+		++$this->executed;
+		if (!$this->_statement->execute()) {
+			return false;
+		}
+
+		if (method_exists($this->_statement, 'get_result')) {
+			$result = $this->_statement->get_result();
+
+			return $result ?: $this->_statement->errno === 0;
+		}
+
+		return $this->_materialise();
+	}
+
+	/**
+	 *  Determine the bind types for the given parameters
+	 *  @name    determineTypes
+	 *  @type    method
+	 *  @access  public
+	 *  @param   array  parameters
+	 *  @returns string types
+	 *  @note    integers and booleans are bound as 'i', floats as 'd' and everything else as 's'
+	 */
+	public function determineTypes(array $param):string {
+		$types = '';
+
+		foreach ($param as $value) {
+			if (is_int($value) || is_bool($value)) {
+				$types .= 'i';
+			}
+			else if (is_float($value)) {
+				$types .= 'd';
+			}
+			else {
+				$types .= 's';
+			}
+		}
+
+		return $types;
+	}
+
+	/**
+	 *  Obtain the connection on which the statement was prepared
+	 *  @name    connection
+	 *  @type    method
+	 *  @access  public
+	 *  @returns MySQLi connection
+	 */
+	public function connection():MySQLi {
+		return $this->_conn;
+	}
+
+	/**
+	 *  Obtain the statement handle
+	 *  @name    handle
+	 *  @type    method
+	 *  @access  public
+	 *  @returns MySQLi_STMT statement
+	 */
+	public function handle():?MySQLi_STMT {
+		return $this->_statement;
+	}
+
+	/**
+	 *  Close the statement, freeing it on the server
+	 *  @name    close
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function close():bool {
+		$result = true;
+
+		if ($this->_statement) {
+			$result = $this->_statement->close();
+			$this->_statement = null;
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Fetch all rows of the executed statement into objects (used if get_result is not available)
+	 *  @name    _materialise
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns mixed  result (array of rows, true for statements without a resultset)
+	 */
+	protected function _materialise():mixed {
+		$meta = $this->_statement->result_metadata();
+		if (!$meta) {
+			return $this->_statement->errno === 0;
+		}
+
+		$this->_statement->store_result();
+
+		$field = Array();
+		$bind  = Array();
+		foreach ($meta->fetch_fields() as $column) {
+			$field[$column->name] = null;
+			$bind[] = &$field[$column->name];
+		}
+		$meta->free();
+
+		call_user_func_array(Array($this->_statement, 'bind_result'), $bind);
+
+		$result = Array();
+		while ($this->_statement->fetch()) {
+			//  copy the values, as the bound references are overwritten by the next fetch
+			$record = new stdClass();
+			foreach ($field as $name=>$value) {
+				$record->{$name} = $value;
+			}
+			$result[] = $record;
+		}
+		$this->_statement->free_result();
+
+		return $result;
+	}
+}
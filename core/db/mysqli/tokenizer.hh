@@ -0,0 +1,444 @@
+<?hh  //  strict
+
+
+/**
+ *  Single pass SQL tokenizer, used to create fingerprints (normalised queries), to determine the tables involved and
+ *  whether the result of a query depends on anything but the data
+ *  @name    CoreDBMySQLiTokenizer
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ */
+class CoreDBMySQLiTokenizer<Konsolidate> extends Konsolidate {
+	const TOKEN_WORD        = 0;  //  keywords, functions and unquoted names
+	const TOKEN_NAME        = 1;  //  `quoted names`
+	const TOKEN_STRING      = 2;  //  'strings', "strings", x'hex', b'bits', N'national' and _charset'strings'
+	const TOKEN_NUMBER      = 3;
+	const TOKEN_VARIABLE    = 4;  //  @user and @@system variables
+	const TOKEN_PLACEHOLDER = 5;  //  ? (prepared statement parameters)
+	const TOKEN_OPERATOR    = 6;
+	const TOKEN_COMMENT     = 7;
+	const TOKEN_HINT        = 8;  //  /*! executable comments */ and /*+ optimizer hints */
+
+	/**
+	 *  The keywords (which are uppercased in normalised queries and never mistaken for table aliases)
+	 *  @name    _keyword
+	 *  @type    Set
+	 *  @access  protected
+	 */
+	protected Set<string> $_keyword;
+
+	/**
+	 *  The functions of which the result depends on the time, session or chance rather than on the data
+	 *  @name    _volatile
+	 *  @type    Set
+	 *  @access  protected
+	 */
+	protected Set<string> $_volatile;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @returns object
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->_keyword = Set<string> {
+			'ALL', 'AND', 'AS', 'ASC', 'BETWEEN', 'BY', 'CASE', 'CROSS', 'DELAYED', 'DELETE', 'DESC', 'DISTINCT',
+			'DUPLICATE', 'ELSE', 'END', 'EXISTS', 'FOR', 'FORCE', 'FROM', 'GROUP', 'HAVING', 'HIGH_PRIORITY',
+			'IGNORE', 'IN', 'INDEX', 'INNER', 'INSERT', 'INTO', 'IS', 'JOIN', 'KEY', 'LEFT', 'LIKE', 'LIMIT', 'LOCK',
+			'LOW_PRIORITY', 'MODE', 'NATURAL', 'NOT', 'NULL', 'OFFSET', 'ON', 'OR', 'ORDER', 'OUTER', 'PARTITION',
+			'QUICK', 'REPLACE', 'RIGHT', 'SELECT', 'SET', 'SHARE', 'STRAIGHT_JOIN', 'TABLE', 'THEN', 'TRUNCATE',
+			'UNION', 'UPDATE', 'USE', 'USING', 'VALUES', 'WHEN', 'WHERE', 'WITH', 'XOR'
+		};
+		$this->_volatile = Set<string> {
+			'BENCHMARK', 'CONNECTION_ID', 'CURDATE', 'CURRENT_DATE', 'CURRENT_TIME', 'CURRENT_TIMESTAMP', 'CURRENT_USER',
+			'CURTIME', 'DATABASE', 'FOUND_ROWS', 'GET_LOCK', 'IS_FREE_LOCK', 'IS_USED_LOCK', 'LAST_INSERT_ID',
+			'LOCALTIME', 'LOCALTIMESTAMP', 'MASTER_POS_WAIT', 'NOW', 'RAND', 'RELEASE_LOCK', 'ROW_COUNT', 'SCHEMA',
+			'SESSION_USER', 'SLEEP', 'SYSDATE', 'SYSTEM_USER', 'UNIX_TIMESTAMP', 'USER', 'UTC_DATE', 'UTC_TIME',
+			'UTC_TIMESTAMP', 'UUID', 'UUID_SHORT'
+		};
+	}
+
+	/**
+	 *  Split a query into tokens
+	 *  @name    tokenize
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns Vector tokens (Pair of type and text), whitespace is omitted
+	 */
+	public function tokenize(string $query):Vector<Pair<int, string>> {
+		$result = Vector<Pair<int, string>> {};
+		$length = strlen($query);
+		$i      = 0;
+
+		while ($i < $length) {
+			$char = $query[$i];
+			$next = $i + 1 < $length ? $query[$i + 1] : '';
+
+			//  whitespace
+			if (ctype_space($char)) {
+				$i += strspn($query, " \t\r\n\f\v", $i);
+				continue;
+			}
+
+			$start = $i;
+			if ($char === '#' || ($char === '-' && $next === '-' && ($i + 2 >= $length || ctype_space($query[$i + 2])))) {
+				$i   += strcspn($query, "\r\n", $i);
+				$type = self::TOKEN_COMMENT;
+			}
+			else if ($char === '/' && $next === '*') {
+				$end  = strpos($query, '*/', $i + 2);
+				$i    = $end === false ? $length : $end + 2;
+				$type = $i - $start > 4 && ($query[$start + 2] === '!' || $query[$start + 2] === '+') ? self::TOKEN_HINT : self::TOKEN_COMMENT;
+			}
+			else if ($char === '\'' || $char === '"') {
+				$i    = $this->_skipQuoted($query, $i, $length);
+				$type = self::TOKEN_STRING;
+			}
+			else if ($char === '`') {
+				$i    = $this->_skipQuoted($query, $i, $length);
+				$type = self::TOKEN_NAME;
+			}
+			else if (ctype_digit($char) || ($char === '.' && ctype_digit($next))) {
+				if ($char === '0' && ($next === 'x' || $next === 'b')) {
+					$i += 2 + strspn($query, $next === 'x' ? '0123456789abcdefABCDEF' : '01', $i + 2);
+				}
+				else {
+					$i += strspn($query, '0123456789.', $i);
+					if ($i < $length && ($query[$i] === 'e' || $query[$i] === 'E')) {
+						$sign = $i + 1 < $length && ($query[$i + 1] === '+' || $query[$i + 1] === '-') ? 1 : 0;
+						if ($i + 1 + $sign < $length && ctype_digit($query[$i + 1 + $sign])) {
+							$i += 1 + $sign + strspn($query, '0123456789', $i + 1 + $sign);
+						}
+					}
+				}
+				$type = self::TOKEN_NUMBER;
+
+				//  names may start with digits (e.g. 1st_table)
+				if ($i < $length && $this->_isWordChar($query[$i])) {
+					$i   += $this->_wordLength($query, $i, $length);
+					$type = self::TOKEN_WORD;
+				}
+			}
+			else if ($this->_isWordChar($char)) {
+				$i   += $this->_wordLength($query, $i, $length);
+				$type = self::TOKEN_WORD;
+
+				//  literal prefixes (x'..', b'..', N'..') and character set introducers (_utf8'..')
+				if ($i < $length && $query[$i] === '\'' && ($i - $start === 1 ? strpos('xXbBnN', $char) !== false : $char === '_')) {
+					$i    = $this->_skipQuoted($query, $i, $length);
+					$type = self::TOKEN_STRING;
+				}
+			}
+			else if ($char === '@') {
+				$i += $next === '@' ? 2 : 1;
+				if ($i < $length && ($query[$i] === '\'' || $query[$i] === '"' || $query[$i] === '`')) {
+					$i = $this->_skipQuoted($query, $i, $length);
+				}
+				else {
+					$i += $this->_wordLength($query, $i, $length);
+					//  system variables may be scoped (@@session.sql_mode)
+					if ($i + 1 < $length && $query[$i] === '.' && $this->_isWordChar($query[$i + 1])) {
+						$i += 1 + $this->_wordLength($query, $i + 1, $length);
+					}
+				}
+				$type = self::TOKEN_VARIABLE;
+			}
+			else if ($char === '?') {
+				++$i;
+				$type = self::TOKEN_PLACEHOLDER;
+			}
+			else {
+				$i   += $this->_operatorLength($query, $i);
+				$type = self::TOKEN_OPERATOR;
+			}
+
+			$result->add(Pair {$type, substr($query, $start, $i - $start)});
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Normalise a query, removing comments and redundant whitespace, uppercasing keywords and optionally replacing
+	 *  the literal values and names
+	 *  @name    normalise
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @param   bool   replace literal values (optional, default true)
+	 *  @param   bool   replace quoted names (optional, default false)
+	 *  @param   Map    replacements (optional, keys 'string', 'number', 'NULL' and 'names')
+	 *  @returns string normalised query
+	 *  @note    When replacing literal values, lists of values (e.g. IN (1, 2, 3)) are reduced to a single value so the
+	 *           normalised query does not depend on the number of values. Without replacement the normalised query
+	 *           is safe to use as key for prepared statements, optimizer hints are retained in that case
+	 */
+	public function normalise(string $query, bool $literal=true, bool $stripName=false, ?Map<string, string> $replace=null):string {
+		$string = $replace && $replace->contains('string') ? $replace->get('string') : '"$"';
+		$number = $replace && $replace->contains('number') ? $replace->get('number') : '#';
+		$null   = $replace && $replace->contains('NULL') ? $replace->get('NULL') : 'NULL';
+		$names  = $replace && $replace->contains('names') ? $replace->get('names') : '`?`';
+		$output = Vector<string> {};
+		$tight  = true;
+
+		foreach ($this->tokenize($query) as $token) {
+			list($type, $text) = $token;
+			$value = null;
+
+			if ($type === self::TOKEN_COMMENT || ($type === self::TOKEN_HINT && $literal)) {
+				continue;
+			}
+
+			switch ($type) {
+				case self::TOKEN_STRING:
+					$value = $literal ? $string : $text;
+					break;
+
+				case self::TOKEN_NUMBER:
+					$value = $literal ? $number : $text;
+					break;
+
+				case self::TOKEN_NAME:
+					$value = $stripName ? $names : $text;
+					break;
+
+				case self::TOKEN_WORD:
+					$upper = strtoupper($text);
+					if ($upper === 'NULL') {
+						$value = $literal ? $null : $upper;
+					}
+					else if ($this->_keyword->contains($upper)) {
+						$value = $upper;
+					}
+					break;
+			}
+			$value = is_null($value) ? $text : $value;
+
+			//  reduce lists of replaced values to a single value
+			if ($literal && ($type === self::TOKEN_STRING || $type === self::TOKEN_NUMBER || $type === self::TOKEN_PLACEHOLDER) && count($output) >= 2 && $output[count($output) - 1] === ',' && $this->_isReplaced($output[count($output) - 2], $string, $number, $null)) {
+				$output->pop();
+				continue;
+			}
+
+			//  separate tokens by a single space, except around punctuation and (comparison) operators
+			$isTight = $type === self::TOKEN_OPERATOR && $text !== '*';
+			if (count($output) && !$tight && !$isTight) {
+				$output->add(' ');
+			}
+			$output->add($value);
+			$tight = $isTight;
+		}
+
+		return trim(implode('', $output));
+	}
+
+	/**
+	 *  Extract the (lowercase, unqualified) names of the tables involved in a query
+	 *  @name    tables
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns Vector tables
+	 */
+	public function tables(string $query):Vector<string> {
+		$result = Vector<string> {};
+		$token  = Vector<Pair<int, string>> {};
+
+		foreach ($this->tokenize($query) as $item) {
+			if ($item[0] !== self::TOKEN_COMMENT && $item[0] !== self::TOKEN_HINT) {
+				$token->add($item);
+			}
+		}
+		$count = count($token);
+
+		for ($i = 0; $i < $count; ++$i) {
+			if ($token[$i][0] !== self::TOKEN_WORD) {
+				continue;
+			}
+
+			//  INSERT and REPLACE may omit INTO (INSERT a VALUES ...), if they do not INTO is encountered next
+			$keyword = strtoupper($token[$i][1]);
+			if (!in_array($keyword, Array('FROM', 'JOIN', 'INTO', 'UPDATE', 'TABLE', 'STRAIGHT_JOIN', 'TRUNCATE', 'INSERT', 'REPLACE'))) {
+				continue;
+			}
+
+			//  ON DUPLICATE KEY UPDATE and FOR UPDATE are followed by columns and options, not by tables
+			if ($keyword === 'UPDATE' && $i > 0 && in_array(strtoupper($token[$i - 1][1]), Array('KEY', 'FOR'))) {
+				continue;
+			}
+
+			//  skip the modifiers (UPDATE LOW_PRIORITY IGNORE a, INSERT DELAYED INTO a, DELETE QUICK FROM a)
+			$j = $i + 1;
+			while ($j < $count && $token[$j][0] === self::TOKEN_WORD && in_array(strtoupper($token[$j][1]), Array('LOW_PRIORITY', 'HIGH_PRIORITY', 'DELAYED', 'QUICK', 'IGNORE'))) {
+				++$j;
+			}
+
+			//  table lists (FROM a, b / UPDATE a, b) are separated by commas
+			while ($j < $count && ($token[$j][0] === self::TOKEN_WORD || $token[$j][0] === self::TOKEN_NAME) && !$this->_keyword->contains(strtoupper($token[$j][1]))) {
+				$name = $token[$j][1];
+				if ($j + 2 < $count && $token[$j + 1][1] === '.' && ($token[$j + 2][0] === self::TOKEN_WORD || $token[$j + 2][0] === self::TOKEN_NAME)) {
+					$j   += 2;
+					$name = $token[$j][1];
+				}
+				$name = strtolower(trim($name, '`'));
+				if ($result->linearSearch($name) < 0) {
+					$result->add($name);
+				}
+				++$j;
+
+				//  skip the alias
+				if ($j < $count && strtoupper($token[$j][1]) === 'AS') {
+					++$j;
+				}
+				if ($j < $count && ($token[$j][0] === self::TOKEN_WORD || $token[$j][0] === self::TOKEN_NAME) && !$this->_keyword->contains(strtoupper($token[$j][1]))) {
+					++$j;
+				}
+
+				if ($j < $count && $token[$j][1] === ',' && ($keyword === 'FROM' || $keyword === 'UPDATE')) {
+					++$j;
+				}
+				else {
+					break;
+				}
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Determine whether the result of a query depends on the data alone, not on variables or volatile functions
+	 *  @name    isDeterministic
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns bool   deterministic
+	 *  @note    Functions are recognised by the opening parenthesis following them, except for the CURRENT_*, LOCAL*
+	 *           and UTC_* functions, which may be used without
+	 */
+	public function isDeterministic(string $query):bool {
+		$token = $this->tokenize($query);
+		$count = count($token);
+
+		for ($i = 0; $i < $count; ++$i) {
+			if ($token[$i][0] === self::TOKEN_VARIABLE) {
+				return false;
+			}
+
+			if ($token[$i][0] === self::TOKEN_WORD && $this->_volatile->contains($upper = strtoupper($token[$i][1]))) {
+				if (($i + 1 < $count && $token[$i + 1][1] === '(') || preg_match('/^(?:CURRENT_|LOCAL|UTC_)/', $upper)) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Determine the position after the quoted string, name or variable starting at given position
+	 *  @name    _skipQuoted
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @param   int    position of the opening quote
+	 *  @param   int    length of the query
+	 *  @returns int    position
+	 *  @note    both backslash escapes and doubled quotes are supported, backslashes do not escape within names
+	 */
+	protected function _skipQuoted(string $query, int $i, int $length):int {
+		$quote = $query[$i++];
+		$stop  = $quote === '`' ? '`' : $quote . '\\';
+
+		while ($i < $length) {
+			$i += strcspn($query, $stop, $i);
+			if ($i >= $length) {
+				break;
+			}
+
+			if ($query[$i] === '\\') {
+				$i += 2;
+			}
+			else if ($i + 1 < $length && $query[$i + 1] === $quote) {
+				$i += 2;
+			}
+			else {
+				return $i + 1;
+			}
+		}
+
+		return $length;
+	}
+
+	/**
+	 *  Determine the length of the operator starting at given position
+	 *  @name    _operatorLength
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @param   int    position
+	 *  @returns int    length
+	 */
+	protected function _operatorLength(string $query, int $i):int {
+		foreach (Array('<=>', '->>', '<=', '>=', '<>', '!=', ':=', '||', '&&', '<<', '>>', '->') as $operator) {
+			if (substr_compare($query, $operator, $i, strlen($operator)) === 0) {
+				return strlen($operator);
+			}
+		}
+
+		return 1;
+	}
+
+	/**
+	 *  Determine the length of the word starting at given position
+	 *  @name    _wordLength
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string query
+	 *  @param   int    position
+	 *  @param   int    length of the query
+	 *  @returns int    length
+	 */
+	protected function _wordLength(string $query, int $i, int $length):int {
+		$start = $i;
+		while ($i < $length && $this->_isWordChar($query[$i])) {
+			++$i;
+		}
+
+		return $i - $start;
+	}
+
+	/**
+	 *  Determine whether the character is part of a word (letters, digits, '_', '$' and multibyte characters)
+	 *  @name    _isWordChar
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string character
+	 *  @returns bool
+	 */
+	protected function _isWordChar(string $char):bool {
+		return ctype_alnum($char) || $char === '_' || $char === '$' || ord($char) >= 0x80;
+	}
+
+	/**
+	 *  Determine whether an output token is a replaced literal value
+	 *  @name    _isReplaced
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string token
+	 *  @param   string string replacement
+	 *  @param   string number replacement
+	 *  @param   string NULL replacement
+	 *  @returns bool
+	 */
+	protected function _isReplaced(string $token, string $string, string $number, string $null):bool {
+		return $token === $string || $token === $number || $token === $null || $token === '?';
+	}
+}
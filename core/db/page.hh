@@ -0,0 +1,369 @@
+<?hh  //  strict
+
+
+/**
+ *  Result page of a keyset (seek) paginated query, the next page continues after the last row of this page instead of
+ *  skipping rows using OFFSET, so every page is as fast as the first
+ *  @name    CoreDBPage
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Pages are created by CoreDB::paginate and can be bound to a block directly (see CoreTemplate::bind)
+ */
+class CoreDBPage<Konsolidate> extends Konsolidate implements Countable {
+	/**
+	 *  The base query
+	 *  @name    _query
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected string $_query;
+
+	/**
+	 *  The ordering keys (column => ASC|DESC)
+	 *  @name    _order
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_order;
+
+	/**
+	 *  The number of rows per page
+	 *  @name    _limit
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_limit;
+
+	/**
+	 *  The key values of the last row of the previous page (null for the first page)
+	 *  @name    _after
+	 *  @type    array
+	 *  @access  protected
+	 */
+	protected ?array $_after;
+
+	/**
+	 *  The rows of the page (null until the page is loaded)
+	 *  @name    _records
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected ?Vector<mixed> $_records;
+
+	/**
+	 *  Whether or not there are more rows after this page
+	 *  @name    _more
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_more;
+
+	/**
+	 *  The position of the iteration over the rows
+	 *  @name    _pointer
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_pointer = 0;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object           parent object
+	 *  @param   string           base query (SELECT, without ORDER BY and LIMIT)
+	 *  @param   KeyedTraversable ordering keys (column => ASC|DESC)
+	 *  @param   int              rows per page
+	 *  @param   string           continuation token (optional, default null, the first page)
+	 *  @returns object
+	 *  @throws  Exception if no ordering keys are given
+	 */
+	public function __construct(Konsolidate $parent, string $query, KeyedTraversable<string, string> $order, int $limit, ?string $token=null) {
+		parent::__construct($parent);
+
+		$this->_query   = rtrim(trim($query), ';');
+		$this->_order   = Map<string, string> {};
+		$this->_limit   = max(1, $limit);
+		$this->_records = null;
+		$this->_more    = false;
+
+		foreach ($order as $column=>$direction) {
+			$this->_order->set($column, strtoupper($direction) === 'DESC' ? 'DESC' : 'ASC');
+		}
+
+		if (!count($this->_order)) {
+			$this->exception('Keyset pagination requires at least one ordering key');
+		}
+
+		$this->_after = $token ? $this->_decode($token) : null;
+	}
+
+	/**
+	 *  Obtain the token continuing after this page
+	 *  @name    token
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string token (null if this is the last page)
+	 */
+	public function token():?string {
+		$this->_load();
+
+		if (!$this->_more) {
+			return null;
+		}
+
+		$last  = $this->_records->lastValue();
+		$value = Array();
+		foreach ($this->_order->keys() as $column) {
+			$value[] = $this->_value($last, $column);
+		}
+
+		return $this->_encode($value);
+	}
+
+	/**
+	 *  Whether or not there are more rows after this page
+	 *  @name    hasMore
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function hasMore():bool {
+		$this->_load();
+
+		return $this->_more;
+	}
+
+	/**
+	 *  Whether or not this is the first page
+	 *  @name    isFirst
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function isFirst():bool {
+		return is_null($this->_after);
+	}
+
+	/**
+	 *  Obtain the rows of the page
+	 *  @name    records
+	 *  @type    method
+	 *  @access  public
+	 *  @returns Vector rows
+	 */
+	public function records():Vector<mixed> {
+		$this->_load();
+
+		return $this->_records;
+	}
+
+	/**
+	 *  Obtain the number of rows of the page
+	 *  @name    count
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int rows
+	 */
+	public function count():int {
+		return count($this->records());
+	}
+
+	/**
+	 *  Iterate the rows of the page (instead of the properties, as Konsolidate does by default)
+	 *  @name    rewind
+	 *  @type    method
+	 *  @access  public
+	 *  @returns mixed  first row
+	 */
+	public function rewind():mixed {
+		$this->_pointer = 0;
+
+		return $this->current();
+	}
+
+	public function valid():bool {
+		return $this->_pointer < count($this->records());
+	}
+
+	public function current():mixed {
+		return $this->valid() ? $this->_records[$this->_pointer] : false;
+	}
+
+	public function key():mixed {
+		return $this->_pointer;
+	}
+
+	public function next():mixed {
+		++$this->_pointer;
+
+		return $this->current();
+	}
+
+	/**
+	 *  Create the keyset query of the page
+	 *  @name    createQuery
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string query
+	 *  @note    The base query is used as derived table, so the ordering keys refer to the columns of its result.
+	 *           MySQL 5.7+ merges the derived table into the query (unless it is grouped or distinct), so the seek
+	 *           condition is applied to the index of the ordering keys. The keys must be unique together and not NULL
+	 */
+	public function createQuery():string {
+		$order = Array();
+		foreach ($this->_order as $column=>$direction) {
+			$order[] = $this->_quoteName($column) . ' ' . $direction;
+		}
+
+		return 'SELECT * FROM (' . $this->_query . ') AS `page`' .
+			($this->_after ? ' WHERE ' . $this->_createCondition($this->_after) : '') .
+			' ORDER BY ' . implode(', ', $order) .
+			' LIMIT ' . ($this->_limit + 1);
+	}
+
+	/**
+	 *  Execute the query of the page (once)
+	 *  @name    _load
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns void
+	 */
+	protected function _load():void {
+		if (!is_null($this->_records)) {
+			return;
+		}
+
+		$this->_records = Vector<mixed> {};
+		$result = $this->call('../query', $this->createQuery());
+
+		if (is_object($result) && $result->errno === 0) {
+			//  one row more than requested is fetched to determine whether there is a next page
+			while (($record = $result->next()) && count($this->_records) < $this->_limit) {
+				$this->_records->add($record);
+			}
+			$this->_more = $result->rows > $this->_limit;
+		}
+	}
+
+	/**
+	 *  Create the seek condition, selecting the rows after the given key values
+	 *  @name    _createCondition
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  key values (in order of the keys)
+	 *  @returns string condition
+	 *  @note    For keys (a ASC, b DESC) this is: a >= x AND (a > x OR (a = x AND b < y)), the leading range on the first
+	 *           key allows the index to be used even though the keys are ordered in different directions
+	 */
+	protected function _createCondition(array $value):string {
+		$column = $this->_order->keys();
+		$any    = Array();
+
+		foreach ($column as $index=>$name) {
+			$all = Array();
+			for ($i = 0; $i < $index; ++$i) {
+				$all[] = $this->_quoteName($column[$i]) . ' = ' . $this->_format($value[$i]);
+			}
+			$all[] = $this->_quoteName($name) . ($this->_order->get($name) === 'DESC' ? ' < ' : ' > ') . $this->_format($value[$index]);
+
+			$any[] = count($all) > 1 ? '(' . implode(' AND ', $all) . ')' : $all[0];
+		}
+
+		$first = $this->_quoteName($column[0]) . ($this->_order->get($column[0]) === 'DESC' ? ' <= ' : ' >= ') . $this->_format($value[0]);
+
+		return count($any) > 1 ? $first . ' AND (' . implode(' OR ', $any) . ')' : $any[0];
+	}
+
+	/**
+	 *  Obtain the value of a column from a row
+	 *  @name    _value
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   mixed  row (object or array)
+	 *  @param   string column
+	 *  @returns mixed  value
+	 */
+	protected function _value(mixed $record, string $column):mixed {
+		if (is_array($record)) {
+			return array_key_exists($column, $record) ? $record[$column] : null;
+		}
+
+		return isset($record->$column) ? $record->$column : null;
+	}
+
+	/**
+	 *  Format a key value for use in the query
+	 *  @name    _format
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   mixed  value
+	 *  @returns string value
+	 */
+	protected function _format(mixed $value):string {
+		if (is_int($value) || is_float($value)) {
+			return (string) $value;
+		}
+
+		return $this->call('../quote', (string) $value);
+	}
+
+	/**
+	 *  Quote a column name
+	 *  @name    _quoteName
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string name
+	 *  @returns string quoted name
+	 */
+	protected function _quoteName(string $name):string {
+		return '`' . str_replace('`', '``', $name) . '`';
+	}
+
+	/**
+	 *  Create the (opaque) continuation token for the given key values
+	 *  @name    _encode
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   array  key values
+	 *  @returns string token
+	 */
+	protected function _encode(array $value):string {
+		$data = json_encode(Array($this->_signature(), $value));
+
+		return rtrim(strtr(base64_encode($data), '+/', '-_'), '=');
+	}
+
+	/**
+	 *  Obtain the key values from a continuation token
+	 *  @name    _decode
+	 *  @type    method
+	 *  @access  protected
+	 *  @param   string token
+	 *  @returns array  key values (null if the token is invalid or belongs to another query)
+	 */
+	protected function _decode(string $token):?array {
+		$data = json_decode(base64_decode(strtr($token, '-_', '+/')), true);
+
+		if (!is_array($data) || count($data) !== 2 || $data[0] !== $this->_signature() || !is_array($data[1]) || count($data[1]) !== count($this->_order)) {
+			$this->call('/Log/write', get_class($this) . ' ignoring invalid continuation token: ' . $token, 3);
+
+			return null;
+		}
+
+		return array_values($data[1]);
+	}
+
+	/**
+	 *  Create the signature of the query and ordering keys, so tokens cannot be used for another query
+	 *  @name    _signature
+	 *  @type    method
+	 *  @access  protected
+	 *  @returns string signature
+	 */
+	protected function _signature():string {
+		return substr(md5($this->_query . '|' . json_encode($this->_order->toArray()) . '|' . $this->get('/Config/DB/pagesecret', '')), 0, 12);
+	}
+}
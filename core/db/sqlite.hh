@@ -0,0 +1,423 @@
+<?hh  //  strict
+
+
+/**
+ *  SQLite Connectivity, intended for local (read-mostly) databases next to the MySQL connections
+ *  @name    CoreDBSQLite
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    The URI is formatted like: sqlite:///path/to/database.db[?mode=ro&mmap=268435456&busy=100], use
+ *           sqlite:///:memory: for an in memory database. The mode is one of 'ro' (read only), 'rw' (read write) or
+ *           'rwc' (read write create, the default). The mmap option (default /Config/SQLite/mmap) is the number of
+ *           bytes of the database file which are memory mapped, so reads do not require any system calls.
+ *           The results are CoreDBMySQLiQuery objects, so they can be used interchangeably
+ */
+class CoreDBSQLite<Konsolidate> extends Konsolidate implements CoreDBDriver {
+	/**
+	 *  The connection URI (parsed url)
+	 *  @name    _URI
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_URI;
+
+	/**
+	 *  The options of the connection URI
+	 *  @name    _option
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_option;
+
+	/**
+	 *  The connection
+	 *  @name    _conn
+	 *  @type    SQLite3
+	 *  @access  protected
+	 */
+	protected ?SQLite3 $_conn;
+
+	/**
+	 *  The prepared statements, by query (least recently used first)
+	 *  @name    _statement
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, CoreDBSQLiteStatement> $_statement;
+
+	/**
+	 *  Whether or not a transaction is going on
+	 *  @name    _transaction
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_transaction;
+
+
+	/**
+	 *  constructor
+	 *  @name    __construct
+	 *  @type    constructor
+	 *  @access  public
+	 *  @param   object parent object
+	 *  @returns object
+	 *  @note    This object is constructed by one of Konsolidates modules
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		//  the results are CoreDBMySQLiQuery objects
+		$this->getRoot()->import('db/mysqli/exception.hh');
+		$this->getRoot()->import('db/mysqli/query.hh');
+
+		$this->_URI         = Map<string, string> {};
+		$this->_option      = Map<string, string> {};
+		$this->_conn        = null;
+		$this->_statement   = Map<string, CoreDBSQLiteStatement> {};
+		$this->_transaction = false;
+	}
+
+	/**
+	 *  Assign the connection DSN
+	 *  @name    setConnection
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string DSN URI
+	 *  @returns bool
+	 */
+	public function setConnection(string $uri):bool {
+		$option = Array();
+		$this->_URI = Map::fromArray(parse_url($uri));
+
+		if (!$this->_URI->get('path')) {
+			$this->exception('Missing required path from the SQLite DSN "' . $uri . '"');
+		}
+
+		parse_str($this->_URI->get('query') ?: '', $option);
+		$this->_option = Map::fromArray($option);
+
+		return true;
+	}
+
+	/**
+	 *  Connect to (open) the database
+	 *  @name    connect
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 *  @throws  CoreDBMySQLiException if the database cannot be opened
+	 */
+	public function connect():bool {
+		if (!$this->isConnected()) {
+			if (!class_exists('SQLite3')) {
+				$this->exception('SQLite3 is not available for the database "' . $this->database() . '"');
+			}
+
+			switch ($this->_option->get('mode')) {
+				case 'ro': $flags = SQLITE3_OPEN_READONLY; break;
+				case 'rw': $flags = SQLITE3_OPEN_READWRITE; break;
+				default:   $flags = SQLITE3_OPEN_READWRITE | SQLITE3_OPEN_CREATE; break;
+			}
+
+			try {
+				$this->_conn = new SQLite3($this->database(), $flags);
+			}
+			catch (Exception $exception) {
+				throw new CoreDBMySQLiException($exception->getMessage(), $exception->getCode() ?: 14);
+			}
+
+			$this->_conn->busyTimeout((int) ($this->_option->get('busy') ?: $this->get('/Config/SQLite/busy', 100)));
+
+			$mmap = (int) ($this->_option->get('mmap') ?: $this->get('/Config/SQLite/mmap', 0));
+			if ($mmap > 0) {
+				$this->_conn->exec('PRAGMA mmap_size=' . $mmap);
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Disconnect from (close) the database
+	 *  @name    disconnect
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 *  @note    An in memory database loses its contents
+	 */
+	public function disconnect():bool {
+		foreach ($this->_statement as $statement) {
+			$statement->close();
+		}
+		$this->_statement->clear();
+
+		if ($this->isConnected()) {
+			if ($this->_transaction) {
+				$this->rollbackTransaction();
+			}
+			$this->_conn->close();
+			$this->_conn = null;
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Check to see whether a connection is established
+	 *  @name    isConnected
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function isConnected():bool {
+		return is_object($this->_conn);
+	}
+
+	/**
+	 *  Query the database
+	 *  @name    query
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @paran   bool   usecache (ignored, reading a local database is as fast as reading a cache)
+	 *  @returns object result
+	 */
+	public function query(string $query, bool $cache=true):?CoreDBSQLiteQuery {
+		if ($this->connect()) {
+			$start     = microtime(true);
+			$statement = @$this->_conn->prepare($query);
+			$result    = $this->instance('Query');
+			$result->populate($query, $statement ? @$statement->execute() : false, $this->_conn, $start);
+
+			return $result;
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Query the database, streaming the resultrows one at a time
+	 *  @name    stream
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query
+	 *  @returns Generator resultrows (indexed by position)
+	 *  @note    The rows are read from the database as they are consumed, errors are logged (as with query), in which
+	 *           case no rows are produced
+	 */
+	public function stream(string $query):Generator<int, mixed, void> {
+		if ($this->connect()) {
+			$statement = @$this->_conn->prepare($query);
+			$source    = $statement ? @$statement->execute() : false;
+
+			if (!$source) {
+				$this->call('/Log/write', get_class($this) . '::stream failed: (' . $this->_conn->lastErrorCode() . ') ' . $this->_conn->lastErrorMsg() . PHP_EOL . '--> ' . $query, 2);
+
+				return;
+			}
+
+			$index = 0;
+			while ($record = $source->fetchArray(SQLITE3_ASSOC)) {
+				yield $index++ => (object) $record;
+			}
+			$source->finalize();
+		}
+	}
+
+	/**
+	 *  Prepare a query for (repeated) execution
+	 *  @name    prepare
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @returns object statement
+	 *  @note    The number of statements kept is limited by /Config/SQLite/statementcache (default 32), the least
+	 *           recently used statement is closed when the limit is exceeded
+	 */
+	public function prepare(string $query):?CoreDBSQLiteStatement {
+		if ($this->_statement->contains($query)) {
+			//  move the statement to the end, marking it as most recently used
+			$statement = $this->_statement->get($query);
+			$this->_statement->remove($query);
+			$this->_statement->set($query, $statement);
+
+			return $statement;
+		}
+
+		if ($this->connect()) {
+			$statement = $this->instance('Statement');
+			$statement->prepare($query, $this->_conn);
+
+			$this->_statement->set($query, $statement);
+			while (count($this->_statement) > max(1, (int) $this->get('/Config/SQLite/statementcache', 32))) {
+				$this->_statement->get($this->_statement->firstKey())->close();
+				$this->_statement->remove($this->_statement->firstKey());
+			}
+
+			return $statement;
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Execute a parameterised query
+	 *  @name    execute
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string query (using '?' placeholders for the parameters)
+	 *  @param   array  parameters (optional, default none)
+	 *  @param   string types (ignored, the parameters are bound by their own type)
+	 *  @returns object result
+	 */
+	public function execute(string $query, array $param=Array(), ?string $types=null):?CoreDBSQLiteQuery {
+		$statement = $this->prepare($query);
+
+		if ($statement) {
+			$start  = microtime(true);
+			$result = $this->instance('Query');
+			$result->populate($query, $statement->execute($param), $this->_conn, $start);
+
+			return $result;
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Properly escape a string
+	 *  @name    escape
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string escaped input
+	 */
+	public function escape(string $string):string {
+		return SQLite3::escapeString($string);
+	}
+
+	/**
+	 *  Quote and escape a string
+	 *  @name    quote
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string input
+	 *  @returns string quoted escaped input
+	 *  @note    SQLite does not know backslash escapes, and uses double quotes for names
+	 */
+	public function quote(string $string):string {
+		return '\'' . $this->escape($string) . '\'';
+	}
+
+	/**
+	 *  get the ID of the last inserted record
+	 *  @name    lastInsertID
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int id
+	 */
+	public function lastInsertID():?int {
+		return $this->isConnected() ? $this->_conn->lastInsertRowID() : null;
+	}
+
+	/**
+	 *  get the ID of the last inserted record
+	 *  @name    lastId
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int id
+	 *  @note    alias for lastInsertID
+	 *  @see     lastInsertID
+	 */
+	public function lastId():?int {
+		return $this->lastInsertID();
+	}
+
+	/**
+	 *  Start transaction
+	 *  @name    startTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function startTransaction():bool {
+		if ($this->connect() && !$this->_transaction) {
+			$this->_transaction = $this->_conn->exec('BEGIN');
+		}
+
+		return $this->_transaction;
+	}
+
+	/**
+	 *  End transaction by sending 'COMMIT' or 'ROLLBACK'
+	 *  @name    endTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @param   bool commit [optional, default true]
+	 *  @returns bool success
+	 */
+	public function endTransaction(bool $success=true):bool {
+		if ($this->_transaction) {
+			$this->_transaction = !$this->_conn->exec($success ? 'COMMIT' : 'ROLLBACK');
+		}
+
+		return !$this->_transaction;
+	}
+
+	/**
+	 *  Commit a transaction
+	 *  @name    commitTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function commitTransaction():bool {
+		return $this->endTransaction(true);
+	}
+
+	/**
+	 *  Rollback a transaction
+	 *  @name    rollbackTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool success
+	 */
+	public function rollbackTransaction():bool {
+		return $this->endTransaction(false);
+	}
+
+	/**
+	 *  Determine whether a transaction is going on
+	 *  @name    inTransaction
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool transaction
+	 */
+	public function inTransaction():bool {
+		return $this->_transaction;
+	}
+
+	/**
+	 *  Obtain the server of the connection DSN (the local machine)
+	 *  @name    server
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string server
+	 */
+	public function server():string {
+		return 'localhost';
+	}
+
+	/**
+	 *  Obtain the database (file) of the connection DSN
+	 *  @name    database
+	 *  @type    method
+	 *  @access  public
+	 *  @returns string database
+	 */
+	public function database():string {
+		$path = $this->_URI->get('path');
+
+		return $path === '/:memory:' ? ':memory:' : $path;
+	}
+}
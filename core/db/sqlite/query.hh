@@ -0,0 +1,74 @@
+<?hh  //  strict
+
+
+/**
+ *  SQLite result set, providing the CoreDBMySQLiQuery interface
+ *  @name    CoreDBSQLiteQuery
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    The rows are read entirely, SQLite3 results cannot be counted without reading them. Use
+ *           CoreDBSQLite::stream to read large results one row at a time
+ */
+class CoreDBSQLiteQuery<CoreDBMySQLiQuery> extends CoreDBMySQLiQuery {
+	/**
+	 *  The ID of the inserted record
+	 *  @name    _insertID
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_insertID = 0;
+
+
+	/**
+	 *  Populate the result from an executed statement
+	 *  @name    populate
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string  query
+	 *  @param   mixed   SQLite3Result (false if the statement failed)
+	 *  @param   SQLite3 connection
+	 *  @param   float   start time
+	 *  @returns void
+	 */
+	public function populate(string $query, mixed $source, SQLite3 $connection, float $start):void {
+		$this->query    = $query;
+		$this->_records = null;
+		$this->_pointer = 0;
+		$this->_result  = null;
+		$this->rows     = 0;
+
+		if ($source instanceof SQLite3Result) {
+			if ($source->numColumns()) {
+				$this->_records = Array();
+				while ($record = $source->fetchArray(SQLITE3_ASSOC)) {
+					$this->_records[] = (object) $record;
+				}
+				$this->rows = count($this->_records);
+			}
+			else {
+				$this->rows      = $connection->changes();
+				$this->_insertID = $connection->lastInsertRowID();
+			}
+		}
+
+		$this->duration  = microtime(true) - $start;
+		$this->exception = $source ? new CoreDBMySQLiException('', 0) : new CoreDBMySQLiException($connection->lastErrorMsg(), $connection->lastErrorCode() ?: 1);
+		$this->errno     = &$this->exception->errno;
+		$this->error     = &$this->exception->error;
+
+		if ($this->errno > 0) {
+			$this->call('/Log/write', get_class($this) . '::execute failed: (' . $this->errno . ') ' . $this->error . PHP_EOL . '--> ' . $this->query, 2);
+		}
+	}
+
+	/**
+	 *  get the ID of the last inserted record
+	 *  @name    lastInsertID
+	 *  @type    method
+	 *  @access  public
+	 *  @returns int id
+	 */
+	public function lastInsertID():int {
+		return $this->_insertID;
+	}
+}
@@ -0,0 +1,118 @@
+<?hh  //  strict
+
+
+/**
+ *  SQLite prepared statement
+ *  @name    CoreDBSQLiteStatement
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Statements are created (and cached) by CoreDBSQLite::prepare, use CoreDBSQLite::execute to obtain a
+ *           CoreDBSQLiteQuery result
+ */
+class CoreDBSQLiteStatement<Konsolidate> extends Konsolidate {
+	/**
+	 *  The query
+	 *  @name    query
+	 *  @type    string
+	 *  @access  public
+	 */
+	public string $query;
+
+	/**
+	 *  The number of times the statement was executed
+	 *  @name    executed
+	 *  @type    int
+	 *  @access  public
+	 */
+	public int $executed;
+
+	/**
+	 *  The statement handle
+	 *  @name    _statement
+	 *  @type    SQLite3Stmt
+	 *  @access  protected
+	 */
+	protected ?SQLite3Stmt $_statement;
+
+
+	/**
+	 *  Prepare the given query on the given connection
+	 *  @name    prepare
+	 *  @type    method
+	 *  @access  public
+	 *  @param   string   query
+	 *  @param   SQLite3  connection
+	 *  @returns bool     success
+	 *  @throws  CoreDBMySQLiException if the query cannot be prepared
+	 */
+	public function prepare(string $query, SQLite3 $connection):bool {
+		$this->query      = $query;
+		$this->executed   = 0;
+		$this->_statement = @$connection->prepare($this->query) ?: null;
+
+		if (!$this->_statement) {
+			$this->call('/Log/write', get_class($this) . '::prepare failed: (' . $connection->lastErrorCode() . ') ' . $connection->lastErrorMsg() . PHP_EOL . '--> ' . $this->query, 2);
+
+			throw new CoreDBMySQLiException($connection->lastErrorMsg(), $connection->lastErrorCode() ?: 1);
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Bind the parameters and execute the statement
+	 *  @name    execute
+	 *  @type    method
+	 *  @access  public
+	 *  @param   array    parameters
+	 *  @returns mixed    result (SQLite3Result, false if the statement failed)
+	 */
+	public function execute(array $param=Array()):mixed {
+		$this->_statement->reset();
+		$this->_statement->clear();
+
+		foreach (array_values($param) as $index=>$value) {
+			$this->_statement->bindValue($index + 1, $value, $this->determineType($value));
+		}
+
+		++$this->executed;
+
+		return @$this->_statement->execute();
+	}
+
+	/**
+	 *  Determine the bind type for the given parameter
+	 *  @name    determineType
+	 *  @type    method
+	 *  @access  public
+	 *  @param   mixed  parameter
+	 *  @returns int    type
+	 */
+	public function determineType(mixed $value):int {
+		if (is_null($value)) {
+			return SQLITE3_NULL;
+		}
+		else if (is_int($value) || is_bool($value)) {
+			return SQLITE3_INTEGER;
+		}
+		else if (is_float($value)) {
+			return SQLITE3_FLOAT;
+		}
+
+		return SQLITE3_TEXT;
+	}
+
+	/**
+	 *  Close the statement
+	 *  @name    close
+	 *  @type    method
+	 *  @access  public
+	 *  @returns bool
+	 */
+	public function close():bool {
+		$result = $this->_statement ? $this->_statement->close() : true;
+		$this->_statement = null;
+
+		return $result;
+	}
+}
@@ -4,6 +4,9 @@
 //        This is due to an issue in version up to and including HipHop VM 3.0.1, where insertBefore would raise a fatal
 //        error: "Unexpected object type stdClass."
 
+//  the engine interface must be declared before CoreTemplate, which is the first template module to be imported
+require_once __DIR__ . '/template/engine/interface.hh';
+
 
 /**
  *  Template class
@@ -11,7 +14,7 @@
  *  @package Konsolidate
  *  @author  Rogier Spieker <rogier@konsolidate.nl>
  */
-class CoreTemplate<Konsolidate> extends Konsolidate {
+class CoreTemplate<Konsolidate> extends Konsolidate implements CoreTemplateEngineInterface {
 	const PHASE_INIT        = 'PHASE:init';
 	const PHASE_PREPARE     = 'PHASE:prepare';
 	const PHASE_READY       = 'PHASE:ready';
@@ -250,6 +253,31 @@ class CoreTemplate<Konsolidate> extends Konsolidate {
 		return false;
 	}
 
+	/**
+	 *  Populate a block-feature (<k:block name="xx">) with a row for every item, each item provides the block variables
+	 *  @name   bind
+	 *  @type   method
+	 *  @access public
+	 *  @param  string      name
+	 *  @param  Traversable items (e.g. CoreDBMySQLi::stream)
+	 *  @return int number of items
+	 *  @note   The items are rendered as they are read, so rows are not kept in memory (this also means the rows
+	 *          are placed before any rows created using block)
+	 */
+	public function bind(string $name, Traversable<mixed> $items):int {
+		$list  = $this->getFeatures('block', Array('name'=>$name));
+		$count = 0;
+
+		foreach ($items as $item) {
+			foreach ($list as $feature) {
+				$feature->append($item);
+			}
+			++$count;
+		}
+
+		return $count;
+	}
+
 	/**
 	 *  Obtain the current state of the internal DOM template
 	 *  @name   getDOM
@@ -289,6 +317,25 @@ class CoreTemplate<Konsolidate> extends Konsolidate {
 		return $asDOM ? $dom : trim($dom->saveHTML());
 	}
 
+	/**
+	 *  Render the template asynchronously, resolving placeholder values and child templates concurrently before the
+	 *  results are spliced into the template (in order)
+	 *  @name   genRender
+	 *  @type   method
+	 *  @access public
+	 *  @param  bool replace (default true)
+	 *  @param  bool asDOM (default false)
+	 *  @return Awaitable string HTML or DOMDocument
+	 *  @note   Placeholder values may be Awaitables (e.g. asynchronous queries), these are awaited alongside the child
+	 *          templates and blocks. As all DOM manipulation takes place on the request thread, the wall-clock gain
+	 *          comes from overlapping the I/O the (child) templates are waiting for.
+	 */
+	public async function genRender(bool $replace=true, bool $asDOM=false):Awaitable<mixed> {
+		await $this->_genResolve($replace);
+
+		return $this->render($replace, $asDOM);
+	}
+
 	/**
 	 *  Register a hook callback
 	 *  @name   addHook
@@ -381,6 +428,54 @@ class CoreTemplate<Konsolidate> extends Konsolidate {
 		}
 	}
 
+	/**
+	 *  Concurrently resolve all Awaitable and CoreTemplate placeholder values and let features render their children
+	 *  @name   _genResolve
+	 *  @type   method
+	 *  @access protected
+	 *  @param  bool replace
+	 *  @return Awaitable void
+	 */
+	protected async function _genResolve(bool $replace):Awaitable<void> {
+		$pending = Vector<Awaitable<mixed>> {};
+
+		if ($replace) {
+			foreach ($this->_property as $key=>$value) {
+				if ($value instanceof Awaitable) {
+					$pending[] = $this->_genAssign($key, $value);
+				}
+				else if ($value instanceof CoreTemplate) {
+					$pending[] = $this->_genAssign($key, $value->genRender(true, true));
+				}
+			}
+		}
+
+		//  features may render (child templates) ahead of the actual rendering, e.g. CoreTemplateFeatureBlock
+		foreach ($this->_feature as $name=>$instances) {
+			foreach ($instances as $instance) {
+				if (method_exists($instance, 'genRender')) {
+					$pending[] = $instance->genRender();
+				}
+			}
+		}
+
+		await \HH\Asio\v($pending);
+	}
+
+	/**
+	 *  Await a placeholder value and store the result
+	 *  @name   _genAssign
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string key
+	 *  @param  Awaitable value
+	 *  @return Awaitable void
+	 *  @note   The assignment hooks have already been triggered when the original value was assigned
+	 */
+	protected async function _genAssign(string $key, Awaitable<mixed> $value):Awaitable<void> {
+		$this->_property[$key] = await $value;
+	}
+
 	/**
 	 *  Remove any wrapping applied earlier and trigger the feature rendering
 	 *  @name   _render
@@ -426,7 +521,7 @@ class CoreTemplate<Konsolidate> extends Konsolidate {
 		$value = isset($this->_property[$key]) ? $this->_property[$key] : $default;
 
 		if (!is_string($value) && !is_numeric($value)) {
-			if ($value instanceof CoreTemplate) {
+			if ($value instanceof CoreTemplate || $value instanceof CoreTemplateToken) {
 				$value = $value->render(true, true);
 			}
 
@@ -678,13 +773,15 @@ class CoreTemplate<Konsolidate> extends Konsolidate {
 	 *  @param  string key
 	 *  @param  mixed  value
 	 *  @return void
+	 *  @note   Properties are placeholder values, they are stored without verifying whether a module of the same name
+	 *          is available (e.g. {token} or {cache}), as the template modules are not accessed as properties
 	 */
 	public function __set(string $property, mixed $value):void {
 		$this->_enterPhase(self::PHASE_ASSIGN, Array(
 			'property' => &$property,
 			'value'    => &$value
 		));
-		parent::__set($property, $value);
+		$this->_property[$property] = $value;
 	}
 
 	/**
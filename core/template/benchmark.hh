@@ -0,0 +1,542 @@
+<?hh  //  strict
+
+
+/**
+ *  Template benchmark, rendering a set of representative fixtures and reporting the time spent in each phase
+ *  @name    CoreTemplateBenchmark
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Phase timings are taken from the CoreTemplate PHASE_* hooks of the outermost template, memory is reported
+ *           as the growth during a run and the process peak (HHVM does not expose allocation counts)
+ */
+class CoreTemplateBenchmark<Konsolidate> extends Konsolidate {
+	/**
+	 *  The fixtures available to the benchmark
+	 *  @name    _fixture
+	 *  @type    Vector
+	 *  @access  protected
+	 */
+	protected Vector<string> $_fixture;
+
+	/**
+	 *  The directory in which file based fixtures are created
+	 *  @name    _directory
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected ?string $_directory;
+
+
+	/**
+	 *  Constructor
+	 *  @name   __construct
+	 *  @type   method
+	 *  @access public
+	 *  @param  Konsolidate $parent
+	 *  @return CoreTemplateBenchmark
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->_fixture = Vector<string> {
+			'include',
+			'block',
+			'entity',
+			'csp',
+			'filter'
+		};
+		$this->_directory = null;
+	}
+
+	/**
+	 *  Obtain the names of the available fixtures
+	 *  @name   fixtures
+	 *  @type   method
+	 *  @access public
+	 *  @return Vector fixture names
+	 */
+	public function fixtures():Vector<string> {
+		return $this->_fixture;
+	}
+
+	/**
+	 *  Run the benchmark
+	 *  @name   run
+	 *  @type   method
+	 *  @access public
+	 *  @param  Vector fixtures (optional, default all fixtures)
+	 *  @param  int    iterations per fixture (optional, default 5)
+	 *  @param  string engine (optional, default 'dom')
+	 *  @return array  median value of each metric per fixture
+	 */
+	public function run(?Vector<string> $fixtures=null, int $iterations=5, string $engine='dom'):array<string, array<string, float>> {
+		$result = Array();
+
+		foreach ($fixtures ?: $this->_fixture as $fixture) {
+			if ($this->_fixture->linearSearch($fixture) < 0) {
+				$this->exception('Unknown template benchmark fixture "' . $fixture . '"');
+			}
+
+			$sample = Array();
+			for ($i = 0; $i < max(1, $iterations); ++$i) {
+				foreach ($this->_measure($fixture, $engine) as $metric=>$value) {
+					$sample[$metric][] = $value;
+				}
+			}
+
+			$result[$fixture] = Array();
+			foreach ($sample as $metric=>$list) {
+				$result[$fixture][$metric] = $this->_median($list);
+			}
+		}
+
+		$this->_cleanup();
+
+		return $result;
+	}
+
+	/**
+	 *  Create a human readable report, comparing the results to a baseline (if provided)
+	 *  @name   report
+	 *  @type   method
+	 *  @access public
+	 *  @param  array  results
+	 *  @param  array  baseline (optional)
+	 *  @param  float  tolerance (optional, default 0.1, the relative growth allowed before reporting a regression)
+	 *  @return string report
+	 */
+	public function report(array<string, array<string, float>> $result, ?array $baseline=null, float $tolerance=0.1):string {
+		$report = Array();
+		foreach ($result as $fixture=>$metric) {
+			$report[] = $fixture;
+			foreach ($metric as $name=>$value) {
+				$line = sprintf('  %-22s %14s', $name, $this->_format($name, $value));
+
+				if (isset($baseline[$fixture][$name]) && $baseline[$fixture][$name] > 0) {
+					$delta = ($value - $baseline[$fixture][$name]) / $baseline[$fixture][$name];
+					$line .= sprintf('  %+7.1f%%', $delta * 100) . ($this->_isRegression($name, $delta, $tolerance) ? '  REGRESSION' : '');
+				}
+				else if (is_array($baseline) && !$this->_isInformative($name)) {
+					$line .= '  NO BASELINE';
+				}
+
+				$report[] = $line;
+			}
+		}
+
+		return implode(PHP_EOL, $report) . PHP_EOL;
+	}
+
+	/**
+	 *  Obtain the list of regressions compared to a baseline
+	 *  @name   regressions
+	 *  @type   method
+	 *  @access public
+	 *  @param  array  results
+	 *  @param  array  baseline
+	 *  @param  float  tolerance (optional, default 0.1)
+	 *  @return Vector regressions ('fixture/metric')
+	 */
+	public function regressions(array<string, array<string, float>> $result, array $baseline, float $tolerance=0.1):Vector<string> {
+		$regression = Vector<string> {};
+		foreach ($result as $fixture=>$metric) {
+			foreach ($metric as $name=>$value) {
+				if (isset($baseline[$fixture][$name]) && $baseline[$fixture][$name] > 0 && $this->_isRegression($name, ($value - $baseline[$fixture][$name]) / $baseline[$fixture][$name], $tolerance)) {
+					$regression[] = $fixture . '/' . $name;
+				}
+			}
+		}
+
+		return $regression;
+	}
+
+	/**
+	 *  Obtain the list of measured metrics for which the baseline holds no value
+	 *  @name   missing
+	 *  @type   method
+	 *  @access public
+	 *  @param  array  results
+	 *  @param  array  baseline
+	 *  @return Vector missing ('fixture/metric')
+	 *  @note   The informative metrics (see _isInformative) are not required
+	 */
+	public function missing(array<string, array<string, float>> $result, array $baseline):Vector<string> {
+		$missing = Vector<string> {};
+		foreach ($result as $fixture=>$metric) {
+			foreach ($metric as $name=>$value) {
+				if (!$this->_isInformative($name) && !(isset($baseline[$fixture][$name]) && is_numeric($baseline[$fixture][$name]))) {
+					$missing[] = $fixture . '/' . $name;
+				}
+			}
+		}
+
+		return $missing;
+	}
+
+	/**
+	 *  Read a stored baseline
+	 *  @name   readBaseline
+	 *  @type   method
+	 *  @access public
+	 *  @param  string file
+	 *  @return array  baseline (null if not available)
+	 */
+	public function readBaseline(string $file):?array {
+		if (!is_file($file)) {
+			return null;
+		}
+
+		$baseline = json_decode(file_get_contents($file), true);
+
+		return is_array($baseline) ? $baseline : null;
+	}
+
+	/**
+	 *  Store the results as baseline
+	 *  @name   writeBaseline
+	 *  @type   method
+	 *  @access public
+	 *  @param  string file
+	 *  @param  array  results
+	 *  @param  string engine (optional, default 'dom')
+	 *  @param  int    iterations per fixture (optional, default 5)
+	 *  @return bool   success
+	 *  @note   The circumstances of the run are stored under '_meta', as timings only compare on the same machine
+	 */
+	public function writeBaseline(string $file, array<string, array<string, float>> $result, string $engine='dom', int $iterations=5):bool {
+		ksort($result);
+		$result = array_merge(Array('_meta' => Array(
+			'engine'     => $engine,
+			'iterations' => $iterations,
+			'hhvm'       => defined('HHVM_VERSION') ? HHVM_VERSION : PHP_VERSION,
+			'host'       => php_uname('n') . ' ' . php_uname('m'),
+			'recorded'   => date('c')
+		)), $result);
+
+		return file_put_contents($file, json_encode($result, JSON_PRETTY_PRINT) . PHP_EOL) !== false;
+	}
+
+	/**
+	 *  Measure a single run of a fixture
+	 *  @name   _measure
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string fixture
+	 *  @param  string engine
+	 *  @return array  metrics
+	 */
+	protected function _measure(string $fixture, string $engine):array<string, float> {
+		$source = call_user_func(Array($this, '_source' . ucFirst($fixture)));
+		$memory = memory_get_usage();
+		$phase  = Array();
+		$start  = microtime(true);
+
+		if ($engine === 'dom') {
+			$template = $this->instance('/Template');
+			foreach (Array(CoreTemplate::PHASE_INIT, CoreTemplate::PHASE_PREPARE, CoreTemplate::PHASE_READY, CoreTemplate::PHASE_REPLACE, CoreTemplate::PHASE_PRE_RENDER, CoreTemplate::PHASE_RENDER) as $name) {
+				$template->addHook($name, function($hook) use (&$phase) {
+					$phase[$hook->type] = microtime(true);
+				});
+			}
+			$template->load($source);
+		}
+		else {
+			$template = $this->call('/Template/Engine/create', $source, $engine);
+		}
+
+		$loaded = microtime(true);
+		call_user_func(Array($this, '_populate' . ucFirst($fixture)), $template);
+		$populated = microtime(true);
+		$output    = $template->render();
+		$end       = microtime(true);
+
+		$result = Array(
+			'load'     => $loaded - $start,
+			'populate' => $populated - $loaded,
+			'render'   => $end - $populated,
+			'total'    => $end - $start
+		);
+
+		//  the duration of each phase is the time until the next phase was entered
+		$previous = null;
+		foreach ($phase as $name=>$time) {
+			if ($previous) {
+				$result[$previous] = $time - $phase[$previous];
+			}
+			$previous = $name;
+		}
+		if ($previous) {
+			$result[$previous] = $end - $phase[$previous];
+		}
+
+		$result['memory'] = (float) max(0, memory_get_usage() - $memory);
+		$result['peak']   = (float) memory_get_peak_usage();
+		$result['output'] = (float) strlen($output);
+
+		return $result;
+	}
+
+	/**
+	 *  Determine whether the change of a metric is a regression
+	 *  @name   _isRegression
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string metric
+	 *  @param  float  relative change
+	 *  @param  float  tolerance
+	 *  @return bool   regression
+	 */
+	protected function _isRegression(string $metric, float $delta, float $tolerance):bool {
+		return !$this->_isInformative($metric) && $delta > $tolerance;
+	}
+
+	/**
+	 *  Determine whether a metric is informative only, rather than subject to regression
+	 *  @name   _isInformative
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string metric
+	 *  @return bool   informative
+	 */
+	protected function _isInformative(string $metric):bool {
+		//  the output size and the process peak are informative
+		return in_array($metric, Array('output', 'peak'));
+	}
+
+	/**
+	 *  Format a metric value
+	 *  @name   _format
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string metric
+	 *  @param  float  value
+	 *  @return string formatted value
+	 */
+	protected function _format(string $metric, float $value):string {
+		switch ($metric) {
+			case 'memory':
+			case 'peak':
+			case 'output':
+				return sprintf('%.1f KiB', $value / 1024);
+		}
+
+		return sprintf('%.3f ms', $value * 1000);
+	}
+
+	/**
+	 *  Calculate the median of a list of values
+	 *  @name   _median
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array values
+	 *  @return float median
+	 */
+	protected function _median(array<float> $list):float {
+		sort($list);
+		$middle = (int) floor(count($list) / 2);
+
+		return count($list) % 2 ? $list[$middle] : ($list[$middle - 1] + $list[$middle]) / 2;
+	}
+
+	/**
+	 *  Obtain (and create if needed) the directory holding the file based fixtures
+	 *  @name   _getDirectory
+	 *  @type   method
+	 *  @access protected
+	 *  @return string directory
+	 */
+	protected function _getDirectory():string {
+		if (!$this->_directory) {
+			$this->_directory = sys_get_temp_dir() . '/konsolidate-benchmark-' . getmypid();
+			if (!is_dir($this->_directory)) {
+				mkdir($this->_directory, 0700, true);
+			}
+		}
+
+		return $this->_directory;
+	}
+
+	/**
+	 *  Remove the file based fixtures
+	 *  @name   _cleanup
+	 *  @type   method
+	 *  @access protected
+	 *  @return void
+	 */
+	protected function _cleanup():void {
+		if ($this->_directory && is_dir($this->_directory)) {
+			foreach (glob($this->_directory . '/*') as $file) {
+				unlink($file);
+			}
+			rmdir($this->_directory);
+		}
+		$this->_directory = null;
+	}
+
+	/**
+	 *  Fixture: a chain of 25 nested includes
+	 *  @name   _sourceInclude
+	 *  @type   method
+	 *  @access protected
+	 *  @return string template file
+	 */
+	protected function _sourceInclude():string {
+		$directory = $this->_getDirectory();
+		$depth     = 25;
+
+		for ($i = 0; $i < $depth; ++$i) {
+			$file = $directory . '/include' . $i . '.xml';
+			if (!is_file($file)) {
+				$child = $i < $depth - 1 ? '<k:include file="include' . ($i + 1) . '.xml" />' : '<p>{message}</p>';
+				file_put_contents($file, '<div class="level' . $i . '"><h2>Level {level' . $i . ':' . $i . '}</h2>' . $child . '</div>');
+			}
+		}
+
+		return $directory . '/include0.xml';
+	}
+
+	/**
+	 *  Fixture data for the include chain
+	 *  @name   _populateInclude
+	 *  @type   method
+	 *  @access protected
+	 *  @param  mixed template
+	 *  @return void
+	 */
+	protected function _populateInclude(mixed $template):void {
+		$template->message = 'Reached the bottom of the include chain';
+	}
+
+	/**
+	 *  Fixture: a table of 10000 block rows
+	 *  @name   _sourceBlock
+	 *  @type   method
+	 *  @access protected
+	 *  @return string template
+	 */
+	protected function _sourceBlock():string {
+		return '<table><thead><tr><th>#</th><th>Name</th><th>Value</th></tr></thead><tbody><k:block name="row"><tr class="{_parity}"><td>{id}</td><td>{name}</td><td title="{title}">{value}</td></tr></k:block></tbody></table>';
+	}
+
+	/**
+	 *  Fixture data for the block table
+	 *  @name   _populateBlock
+	 *  @type   method
+	 *  @access protected
+	 *  @param  mixed template
+	 *  @return void
+	 */
+	protected function _populateBlock(mixed $template):void {
+		for ($i = 0; $i < 10000; ++$i) {
+			$row = $template->block('row');
+			$row->id    = $i;
+			$row->name  = 'Row ' . $i;
+			$row->value = $i * 3.14;
+			$row->title = $i % 3 ? 'Value of row ' . $i : '';
+		}
+	}
+
+	/**
+	 *  Fixture: a document with 5000 named entities
+	 *  @name   _sourceEntity
+	 *  @type   method
+	 *  @access protected
+	 *  @return string template
+	 */
+	protected function _sourceEntity():string {
+		$entity = Array('nbsp', 'copy', 'eacute', 'hellip', 'mdash', 'laquo', 'raquo', 'euro', 'trade', 'deg');
+		$source = '<div>';
+		for ($i = 0; $i < 500; ++$i) {
+			$source .= '<p>';
+			foreach ($entity as $name) {
+				$source .= 'Text&' . $name . ';';
+			}
+			$source .= '</p>';
+		}
+
+		return $source . '</div>';
+	}
+
+	/**
+	 *  Fixture data for the entity document
+	 *  @name   _populateEntity
+	 *  @type   method
+	 *  @access protected
+	 *  @param  mixed template
+	 *  @return void
+	 */
+	protected function _populateEntity(mixed $template):void {
+	}
+
+	/**
+	 *  Fixture: a Content-Security-Policy with 200 (external and inline) requirements
+	 *  @name   _sourceCsp
+	 *  @type   method
+	 *  @access protected
+	 *  @return string template
+	 */
+	protected function _sourceCsp():string {
+		$source = '<html><head><k:csp default="self" img="* data" connect="api.example.com" /><k:style /></head><body>';
+		for ($i = 0; $i < 200; ++$i) {
+			switch ($i % 4) {
+				case 0:
+					$source .= '<k:require file="//cdn' . ($i % 7) . '.example.com/script' . $i . '.js" />';
+					break;
+
+				case 1:
+					$source .= '<k:require file="/style/' . $i . '.css" />';
+					break;
+
+				case 2:
+					$source .= '<k:require type="text/javascript"><![CDATA[window.value' . $i . ' = ' . $i . ';]]></k:require>';
+					break;
+
+				default:
+					$source .= '<k:require file="https://static.example.org/script' . $i . '.js" />';
+					break;
+			}
+		}
+
+		return $source . '<k:script /></body></html>';
+	}
+
+	/**
+	 *  Fixture data for the Content-Security-Policy document
+	 *  @name   _populateCsp
+	 *  @type   method
+	 *  @access protected
+	 *  @param  mixed template
+	 *  @return void
+	 */
+	protected function _populateCsp(mixed $template):void {
+	}
+
+	/**
+	 *  Fixture: a page with lots of work for the comment and whitespace filters
+	 *  @name   _sourceFilter
+	 *  @type   method
+	 *  @access protected
+	 *  @return string template
+	 */
+	protected function _sourceFilter():string {
+		$source = '<html><head>  <title>  {title}  </title>  </head><body>';
+		for ($i = 0; $i < 1000; ++$i) {
+			$source .= PHP_EOL . '  <!-- section ' . $i . ' -->' . PHP_EOL . '  <div class="section">' . PHP_EOL . "\t\t" . '<p>   {text}   </p>' . PHP_EOL . '    <pre>  keep   ' . $i . '  </pre>  ' . PHP_EOL . '  </div>';
+		}
+
+		return $source . '</body></html>';
+	}
+
+	/**
+	 *  Fixture data for the filter page
+	 *  @name   _populateFilter
+	 *  @type   method
+	 *  @access protected
+	 *  @param  mixed template
+	 *  @return void
+	 */
+	protected function _populateFilter(mixed $template):void {
+		$template->title = 'Filter benchmark';
+		$template->text  = 'Lorem    ipsum   dolor sit    amet';
+	}
+}
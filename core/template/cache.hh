@@ -0,0 +1,271 @@
+<?hh  //  strict
+
+
+/**
+ *  Cache for compiled template artifacts (such as computed headers), shared between all templates in the process and,
+ *  if APC is available, between requests. If a cache path is configured, entries are also written to disk so they can
+ *  be prepared ahead of time by another process (see CoreTemplateWarmup). Entries on disk which have not been read for
+ *  /Config/Template/cachefilettl seconds (default a week) are removed
+ *  @name    CoreTemplateCache
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ */
+class CoreTemplateCache<Konsolidate> extends Konsolidate {
+	/**
+	 *  The in-process store
+	 *  @name    _store
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	static protected ?Map<string, mixed> $_store;
+
+	/**
+	 *  Whether or not the APC user cache is used to share entries between requests
+	 *  @name    _shared
+	 *  @type    bool
+	 *  @access  protected
+	 */
+	protected bool $_shared;
+
+	/**
+	 *  The default time to live for shared entries
+	 *  @name    _ttl
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_ttl;
+
+	/**
+	 *  The directory in which entries are stored for other processes (null if not configured)
+	 *  @name    _directory
+	 *  @type    string
+	 *  @access  protected
+	 */
+	protected ?string $_directory;
+
+	/**
+	 *  The time in seconds after which an unused entry on disk is removed
+	 *  @name    _fileTTL
+	 *  @type    int
+	 *  @access  protected
+	 */
+	protected int $_fileTTL;
+
+
+	/**
+	 *  Constructor
+	 *  @name   __construct
+	 *  @type   method
+	 *  @access public
+	 *  @param  Konsolidate $parent
+	 *  @return CoreTemplateCache
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		if (!static::$_store) {
+			static::$_store = Map<string, mixed> {};
+		}
+
+		$this->_shared  = function_exists('apc_fetch') && (bool) $this->get('/Config/Template/sharedcache', true);
+		$this->_ttl     = (int) $this->get('/Config/Template/cachettl', 3600);
+		$this->_fileTTL = max(1, (int) $this->get('/Config/Template/cachefilettl', 604800));
+
+		$directory = $this->get('/Config/Template/cachepath');
+		$this->_directory = $directory && (is_dir($directory) || mkdir($directory, 0755, true)) ? realpath($directory) : null;
+	}
+
+	/**
+	 *  Create a cache key from any number of (scalar or serializable) components
+	 *  @name   key
+	 *  @type   method
+	 *  @access public
+	 *  @param  mixed component N
+	 *  @return string key
+	 */
+	public function key():string {
+		return md5(serialize(func_get_args()));
+	}
+
+	/**
+	 *  Obtain a cached value
+	 *  @name   fetch
+	 *  @type   method
+	 *  @access public
+	 *  @param  string key
+	 *  @param  mixed  default (optional, default null)
+	 *  @return mixed value
+	 */
+	public function fetch(string $key, mixed $default=null):mixed {
+		if (static::$_store->contains($key)) {
+			return static::$_store->get($key);
+		}
+
+		if ($this->_shared) {
+			$success = false;
+			$value   = apc_fetch($this->_sharedKey($key), $success);
+
+			if ($success) {
+				static::$_store->set($key, $value);
+
+				return $value;
+			}
+		}
+
+		if ($this->_directory && is_file($this->_fileName($key)) && !$this->_isExpired($this->_fileName($key))) {
+			$value = unserialize(file_get_contents($this->_fileName($key)));
+
+			if ($value !== false) {
+				//  the modification time marks the last use, so entries in use are never removed
+				@touch($this->_fileName($key));
+				static::$_store->set($key, $value);
+				if ($this->_shared) {
+					apc_store($this->_sharedKey($key), $value, $this->_ttl);
+				}
+
+				return $value;
+			}
+		}
+
+		return $default;
+	}
+
+	/**
+	 *  Store a value
+	 *  @name   store
+	 *  @type   method
+	 *  @access public
+	 *  @param  string key
+	 *  @param  mixed  value
+	 *  @param  int    time to live in seconds for the shared cache (optional, default the configured cachettl)
+	 *  @return bool   success
+	 */
+	public function store(string $key, mixed $value, ?int $ttl=null):bool {
+		static::$_store->set($key, $value);
+		$result = true;
+
+		if ($this->_shared) {
+			$result = (bool) apc_store($this->_sharedKey($key), $value, is_null($ttl) ? $this->_ttl : $ttl);
+		}
+
+		if ($this->_directory) {
+			//  write to a temporary file first, so other processes never read a partially written entry
+			//  tempnam creates the file readable by its owner only, while the entries are read by other processes
+			$temp   = tempnam($this->_directory, 'tmp');
+			$result = $temp && file_put_contents($temp, serialize($value)) !== false && chmod($temp, 0644) && rename($temp, $this->_fileName($key)) && $result;
+			$this->_collectGarbage();
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Verify whether a key is available in the cache
+	 *  @name   contains
+	 *  @type   method
+	 *  @access public
+	 *  @param  string key
+	 *  @return bool   contains
+	 */
+	public function contains(string $key):bool {
+		return static::$_store->contains($key) || ($this->_shared && apc_exists($this->_sharedKey($key))) || ($this->_directory && is_file($this->_fileName($key)));
+	}
+
+	/**
+	 *  Remove a value
+	 *  @name   remove
+	 *  @type   method
+	 *  @access public
+	 *  @param  string key
+	 *  @return void
+	 */
+	public function remove(string $key):void {
+		static::$_store->remove($key);
+
+		if ($this->_shared) {
+			apc_delete($this->_sharedKey($key));
+		}
+
+		if ($this->_directory && is_file($this->_fileName($key))) {
+			unlink($this->_fileName($key));
+		}
+	}
+
+	/**
+	 *  Remove the entries on disk which have not been used for the configured cachefilettl, as well as temporary files
+	 *  left behind by interrupted writes
+	 *  @name   prune
+	 *  @type   method
+	 *  @access public
+	 *  @return int    number of files removed
+	 */
+	public function prune():int {
+		$count = 0;
+
+		if ($this->_directory) {
+			foreach (array_merge(glob($this->_directory . '/*.cache') ?: Array(), glob($this->_directory . '/tmp*') ?: Array()) as $file) {
+				if ($this->_isExpired($file) && @unlink($file)) {
+					++$count;
+				}
+			}
+		}
+
+		return $count;
+	}
+
+	/**
+	 *  Remove the expired entries on disk (at most once a minute per process)
+	 *  @name   _collectGarbage
+	 *  @type   method
+	 *  @access protected
+	 *  @return void
+	 */
+	protected function _collectGarbage():void {
+		static $collected = 0;
+
+		if ($collected > time() - 60) {
+			return;
+		}
+		$collected = time();
+
+		$this->prune();
+	}
+
+	/**
+	 *  Determine whether the file on disk has not been used for the configured cachefilettl
+	 *  @name   _isExpired
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string file name
+	 *  @return bool   expired
+	 */
+	protected function _isExpired(string $file):bool {
+		$modified = @filemtime($file);
+
+		return $modified !== false && $modified < time() - $this->_fileTTL;
+	}
+
+	/**
+	 *  Prefix the key so template entries do not collide with other APC users
+	 *  @name   _sharedKey
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string key
+	 *  @return string key
+	 */
+	protected function _sharedKey(string $key):string {
+		return __CLASS__ . ':' . $key;
+	}
+
+	/**
+	 *  Obtain the file name for the entry on disk
+	 *  @name   _fileName
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string key
+	 *  @return string file name
+	 */
+	protected function _fileName(string $key):string {
+		return $this->_directory . '/' . preg_replace('/[^a-zA-Z0-9_-]/', '_', $key) . '.cache';
+	}
+}
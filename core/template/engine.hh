@@ -0,0 +1,93 @@
+<?hh  //  strict
+
+
+/**
+ *  Template engine selection, creating templates using either the DOM engine (CoreTemplate) or any other engine
+ *  @name    CoreTemplateEngine
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    An engine is a module implementing CoreTemplateEngineInterface (load, block, bind, render and
+ *           getPathList) and the magic property setter for placeholder values. The DOM engine is the only engine
+ *           providing phase hooks (addHook) and features beyond <k:block />, <k:include />, <k:require />, <k:script />
+ *           and <k:style />.
+ */
+class CoreTemplateEngine<Konsolidate> extends Konsolidate {
+	/**
+	 *  The available engines (name => module path)
+	 *  @name    _engine
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, string> $_engine;
+
+
+	/**
+	 *  Constructor
+	 *  @name   __construct
+	 *  @type   method
+	 *  @access public
+	 *  @param  Konsolidate $parent
+	 *  @return CoreTemplateEngine
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->_engine = Map<string, string> {
+			'dom'   => '/Template',
+			'token' => '/Template/Token'
+		};
+	}
+
+	/**
+	 *  Add (or replace) an engine
+	 *  @name   add
+	 *  @type   method
+	 *  @access public
+	 *  @param  string name
+	 *  @param  string module path
+	 *  @return CoreTemplateEngine
+	 */
+	public function add(string $name, string $module):CoreTemplateEngine {
+		$this->_engine->set(strtolower($name), $module);
+
+		return $this;
+	}
+
+	/**
+	 *  Create a template using the given (or configured) engine
+	 *  @name   create
+	 *  @type   method
+	 *  @access public
+	 *  @param  mixed  source
+	 *  @param  string engine (optional, default the configured /Config/Template/engine or 'dom')
+	 *  @return CoreTemplateEngineInterface template
+	 *  @note   The 'auto' engine uses the token engine if the template (and its includes) only uses features
+	 *          supported by the token engine, falling back onto the DOM engine otherwise. Templates which need phase
+	 *          hooks should explicitly use the 'dom' engine.
+	 */
+	public function create(mixed $source=null, ?string $engine=null):CoreTemplateEngineInterface {
+		$engine = strtolower($engine ?: $this->get('/Config/Template/engine', 'dom'));
+
+		if ($engine === 'auto') {
+			if (is_string($source) && !empty($source)) {
+				$template = $this->instance($this->_engine->get('token'), $source);
+				if ($template->isSupported()) {
+					return $template;
+				}
+			}
+
+			$engine = 'dom';
+		}
+
+		if (!$this->_engine->contains($engine)) {
+			$this->exception('Unknown template engine "' . $engine . '"');
+		}
+
+		$template = $this->instance($this->_engine->get($engine), $source);
+		if (!($template instanceof CoreTemplateEngineInterface)) {
+			$this->exception('Template engine "' . $engine . '" does not implement CoreTemplateEngineInterface');
+		}
+
+		return $template;
+	}
+}
@@ -0,0 +1,63 @@
+<?hh  //  strict
+
+
+/**
+ *  Template engine, the interface CoreTemplateEngine expects of the templates it creates
+ *  @name    CoreTemplateEngineInterface
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Placeholder values are assigned using the magic property setter, which cannot be part of the interface.
+ *           Only the DOM engine (CoreTemplate) provides phase hooks (addHook)
+ */
+interface CoreTemplateEngineInterface {
+	/**
+	 *  Load template data from a string or file
+	 *  @name   load
+	 *  @type   method
+	 *  @access public
+	 *  @param  string source
+	 *  @return CoreTemplateEngineInterface
+	 */
+	public function load(string $source):CoreTemplateEngineInterface;
+
+	/**
+	 *  Obtain the list of paths where templates are (configured to be) found
+	 *  @name   getPathList
+	 *  @type   method
+	 *  @access public
+	 *  @return array path
+	 */
+	public function getPathList():array<string>;
+
+	/**
+	 *  Duplicate the contents of a block (<k:block name="xx">)
+	 *  @name   block
+	 *  @type   method
+	 *  @access public
+	 *  @param  string name
+	 *  @return mixed template or group
+	 */
+	public function block(string $name):mixed;
+
+	/**
+	 *  Populate a block (<k:block name="xx">) with a row for every item, each item provides the block variables
+	 *  @name   bind
+	 *  @type   method
+	 *  @access public
+	 *  @param  string      name
+	 *  @param  Traversable items
+	 *  @return int number of items
+	 */
+	public function bind(string $name, Traversable<mixed> $items):int;
+
+	/**
+	 *  Render the template
+	 *  @name   render
+	 *  @type   method
+	 *  @access public
+	 *  @param  bool replace (default true)
+	 *  @param  bool asDOM (default false)
+	 *  @return mixed string HTML or DOMDocument
+	 */
+	public function render(bool $replace=true, bool $asDOM=false):mixed;
+}
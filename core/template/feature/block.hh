@@ -11,6 +11,8 @@ class CoreTemplateFeatureBlock<CoreTemplateFeature> extends CoreTemplateFeature
 	protected DOMNode $_marker;
 	protected string $_data;
 	protected Vector<CoreTemplate> $_stack;
+	protected ?Vector<DOMDocument> $_rendered;
+	protected int $_appended = 0;
 
 
 	/**
@@ -52,6 +54,27 @@ class CoreTemplateFeatureBlock<CoreTemplateFeature> extends CoreTemplateFeature
 		return $this->_addToStack($instance);
 	}
 
+	/**
+	 *  Render a copy of the block features content populated with the given variables right away
+	 *  @name   append
+	 *  @type   method
+	 *  @access public
+	 *  @param  mixed variables (object or array)
+	 *  @return void
+	 *  @note   As the copy is not kept, requirements (<k:require />) inside the block are not collected
+	 */
+	public function append(mixed $variables):void {
+		$template = $this->instance('/Template');
+		$template->load($this->_data);
+		$this->_getPopulatedTemplate($template, $this->_appended++);
+
+		foreach ($variables as $key=>$value) {
+			$template->{$key} = $value;
+		}
+
+		$this->_insert($template->render(true, true));
+	}
+
 	/**
 	 *  Render the feature
 	 *  @name   render
@@ -66,6 +89,24 @@ class CoreTemplateFeatureBlock<CoreTemplateFeature> extends CoreTemplateFeature
 		return true;
 	}
 
+	/**
+	 *  Render the internal stack of duplicated blocks concurrently, the results are spliced in by render
+	 *  @name   genRender
+	 *  @type   method
+	 *  @access public
+	 *  @return Awaitable void
+	 */
+	public async function genRender():Awaitable<void> {
+		if ($this->_stack) {
+			$pending = Vector<Awaitable<mixed>> {};
+			foreach ($this->_stack as $template) {
+				$pending[] = $template->genRender(true, true);
+			}
+
+			$this->_rendered = await \HH\Asio\v($pending);
+		}
+	}
+
 	/**
 	 *  Add the given template to the internal stack of duplicated blocks
 	 *  @name   _addToStack
@@ -94,17 +135,29 @@ class CoreTemplateFeatureBlock<CoreTemplateFeature> extends CoreTemplateFeature
 	 */
 	protected function _renderStack():void {
 		if ($this->_stack)
-			foreach ($this->_stack as $template) {
-				$dom = $template->render(true, true);
-				foreach ($dom->childNodes as $child) {
-					$this->_marker->parentNode->insertBefore(
-						$this->_marker->ownerDocument->importNode($child, true),
-						$this->_marker
-					);
-				}
+			foreach ($this->_stack as $index=>$template) {
+				//  use the result of genRender if the stack was rendered asynchronously
+				$this->_insert($this->_rendered && $this->_rendered->containsKey($index) ? $this->_rendered[$index] : $template->render(true, true));
 			}
 	}
 
+	/**
+	 *  Insert the rendered block before the marker
+	 *  @name   _insert
+	 *  @type   method
+	 *  @access protected
+	 *  @param  DOMDocument rendered block
+	 *  @return void
+	 */
+	protected function _insert(DOMDocument $dom):void {
+		foreach ($dom->childNodes as $child) {
+			$this->_marker->parentNode->insertBefore(
+				$this->_marker->ownerDocument->importNode($child, true),
+				$this->_marker
+			);
+		}
+	}
+
 	/**
 	 *  Prefill the given template with default variables
 	 *  @name   _getPopulatedTemplate
@@ -12,13 +12,82 @@ class CoreTemplateFeatureCSP<CoreTemplateFeature> extends CoreTemplateFeature {
 	protected Map<string, Map> $_policy;
 
 	/**
-	 *  Do all preparations needed for the feature to do its deed
-	 *  @name   prepare
+	 *  Render the feature (and send the policy header)
+	 *  @name   render
 	 *  @type   method
 	 *  @access public
 	 *  @return bool success
+	 *  @note   The policy only depends on the feature attributes, the required files (and inline script hashes) and the
+	 *          server name, so the header contents are compiled once per signature and cached (see CoreTemplateCache)
+	 */
+	public function render():bool {
+		$requires  = $this->_template->getFeatures('require', null, true);
+		$cache     = $this->_template->register('Cache');
+		$signature = 'csp:' . $this->_signature($requires);
+		$content   = $cache->fetch($signature);
+
+		if (is_null($content)) {
+			$content = $this->_compile($requires);
+			$cache->store($signature, $content);
+		}
+
+		//  send the headers if header content was created
+		if (!empty($content)) {
+			$this->_sendHeader($content);
+		}
+
+		//  let the parent class clean up the feature node
+		return parent::render();
+	}
+
+	/**
+	 *  Create the signature of everything the policy depends on
+	 *  @name   _signature
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array  require features
+	 *  @return string signature
 	 */
-	public function prepare():bool {
+	protected function _signature(array<CoreTemplateFeature> $requires):string {
+		$source = Array();
+		foreach ($requires as $require) {
+			$source[] = $require->type . '|' . $require->file . '|' . $this->_inlineHash($require);
+		}
+
+		return md5(serialize(Array(
+			$this->getAttributes()->toArray(),
+			$source,
+			isset($_SERVER['SERVER_NAME']) ? $_SERVER['SERVER_NAME'] : null,
+			isset($_SERVER['HTTPS'])
+		)));
+	}
+
+	/**
+	 *  Obtain the hash of an inline script requirement
+	 *  @name   _inlineHash
+	 *  @type   method
+	 *  @access protected
+	 *  @param  CoreTemplateFeature require feature
+	 *  @return string source expression (null if the requirement is not an inline script)
+	 *  @note   The features render after the placeholders have been replaced, so the hash covers the final script text
+	 */
+	protected function _inlineHash(CoreTemplateFeature $require):?string {
+		if ($require->file || $require->type !== 'text/javascript') {
+			return null;
+		}
+
+		return $require->digest();
+	}
+
+	/**
+	 *  Compile the policy header contents from the feature attributes and the required files
+	 *  @name   _compile
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array  require features
+	 *  @return string policy header contents (empty if there are no rules)
+	 */
+	protected function _compile(array<CoreTemplateFeature> $requires):string {
 		$policyList = Map {
 			'src' => Vector {
 				'default',
@@ -41,28 +110,15 @@ class CoreTemplateFeatureCSP<CoreTemplateFeature> extends CoreTemplateFeature {
 			}
 		}
 
-		return parent::prepare();
-	}
-
-	/**
-	 *  Render the feature (and send the policy header)
-	 *  @name   render
-	 *  @type   method
-	 *  @access public
-	 *  @return bool success
-	 */
-	public function render():bool {
-		//  obtain all required files and process the javascript/stylesheet urls
-		$requires = $this->_template->getFeatures('require', null, true);
+		//  process the javascript/stylesheet urls and the hashes of inline scripts
 		foreach ($requires as $require) {
-			$type = false;
 			switch ($require->type) {
 				case 'text/css':
 					$this->_addPolicy('style-src', $require->file);
 					break;
 
 				case 'text/javascript':
-					$this->_addPolicy('script-src', $require->file);
+					$this->_addPolicy('script-src', $require->file ?: $this->_inlineHash($require));
 					break;
 			}
 		}
@@ -71,22 +127,16 @@ class CoreTemplateFeatureCSP<CoreTemplateFeature> extends CoreTemplateFeature {
 		$this->_optimizePolicy();
 
 		//  if there are any policy rules, create the header contents
+		$content = '';
 		if (count($this->_policy)) {
-			$content = '';
 			foreach ($this->_policy as $type=>$sources) {
 				if (count($sources)) {
 					$content .= (!empty($content) ? '; ' : '') . $type . ' ' . implode(' ', array_keys($sources));
 				}
 			}
-
-			//  send the headers if header content was created
-			if (!empty($content)) {
-				$this->_sendHeader($content);
-			}
 		}
 
-		//  let the parent class clean up the feature node
-		return parent::render();
+		return $content;
 	}
 
 	/**
@@ -102,6 +152,11 @@ class CoreTemplateFeatureCSP<CoreTemplateFeature> extends CoreTemplateFeature {
 			return;
 		}
 
+		//  hash and nonce sources are not domains
+		if (preg_match('/^(?:sha(?:256|384|512)|nonce)-/', $input)) {
+			return $input;
+		}
+
 		$keyword = Array(
 			//  data-urls
 			'data',
@@ -177,6 +232,12 @@ class CoreTemplateFeatureCSP<CoreTemplateFeature> extends CoreTemplateFeature {
 			case 'unsafe-eval':
 				$rule = '\'' . $rule . '\'';
 				break;
+
+			default:
+				if (preg_match('/^(?:sha(?:256|384|512)|nonce)-/', $rule)) {
+					$rule = '\'' . $rule . '\'';
+				}
+				break;
 		}
 
 		return $rule;
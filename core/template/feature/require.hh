@@ -27,6 +27,26 @@ class CoreTemplateFeatureRequire<CoreTemplateFeature> extends CoreTemplateFeatur
 		return true;
 	}
 
+	/**
+	 *  Create the Content-Security-Policy source expression (hash) for the inline content of the requirement
+	 *  @name   digest
+	 *  @type   method
+	 *  @access public
+	 *  @param  string algorithm (one of sha256, sha384, sha512, default sha256)
+	 *  @return string source expression (null if there is no inline content)
+	 *  @note   The hash must match the script as it is sent, so it is only to be created once the placeholders have been
+	 *          replaced (during the render phase), as CoreTemplateFeatureScript renders the very same value
+	 */
+	public function digest(string $algorithm='sha256'):?string {
+		$source = $this->value();
+
+		if (empty($source)) {
+			return null;
+		}
+
+		return $algorithm . '-' . base64_encode(hash($algorithm, $source, true));
+	}
+
 	/**
 	 *  Determine the MIME type by the file's extension
 	 *  @name   _getMIMEType
@@ -0,0 +1,820 @@
+<?hh  //  strict
+
+
+/**
+ *  Lightweight template engine, parsing the template into a compact token tree instead of a DOMDocument
+ *  @name    CoreTemplateToken
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    Only the common subset of template features is supported: placeholders ({name} and {name:default}),
+ *           <k:block />, <k:include />, <k:require />, <k:script /> and <k:style />. There are no phase hooks, as
+ *           there is no DOM to hook into. Use CoreTemplateEngine to pick the engine best suited for a template.
+ */
+class CoreTemplateToken<Konsolidate> extends Konsolidate implements CoreTemplateEngineInterface {
+	const TOKEN_TEXT        = 0;
+	const TOKEN_PLACEHOLDER = 1;
+	const TOKEN_ATTRIBUTE   = 2;
+	const TOKEN_BLOCK       = 3;
+	const TOKEN_REQUIRE     = 4;
+	const TOKEN_SCRIPT      = 5;
+	const TOKEN_STYLE       = 6;
+
+	const MARKER            = "\x1A";
+	const MAX_DEPTH         = 32;
+
+	protected array $_tree;
+	protected array<string, int> $_dependency;
+	protected array<string> $_unsupported;
+	protected array<string> $_templatePath;
+	protected array<string> $_filters;
+	protected int $_sequence;
+	protected Map<int, Vector<CoreTemplateToken>> $_stack;
+	protected ?CoreTemplateToken $_parentTemplate;
+
+
+	/**
+	 *  Constructor
+	 *  @name   __construct
+	 *  @type   method
+	 *  @access public
+	 *  @param  Konsolidate $parent
+	 *  @param  string source
+	 *  @param  CoreTemplateToken parentTemplate
+	 *  @return CoreTemplateToken
+	 */
+	public function __construct(Konsolidate $parent, ?string $source=null, ?CoreTemplateToken $parentTemplate=null) {
+		parent::__construct($parent);
+
+		$this->_tree        = Array();
+		$this->_dependency  = Array();
+		$this->_unsupported = Array();
+		$this->_sequence    = 0;
+		$this->_stack       = Map<int, Vector<CoreTemplateToken>> {};
+
+		$filters = $this->get('/Config/Template/filters', 'comment, whitespace');
+		$this->_filters = !empty($filters) && !$parentTemplate ? preg_split('/\s*,\s*/', $filters) : Array();
+
+		//  configure template paths
+		if ($parentTemplate) {
+			$this->_templatePath = $parentTemplate->getPathList();
+		}
+		else {
+			$this->_templatePath = Array();
+			$path = realpath($this->get('/Config/Template/path'));
+
+			if ($path) {
+				$this->_templatePath[] = $path;
+			}
+
+			if (defined('DOCUMENT_ROOT') && realpath(DOCUMENT_ROOT) && !in_array(DOCUMENT_ROOT, $this->_templatePath)) {
+				$this->_templatePath[] = DOCUMENT_ROOT;
+			}
+		}
+
+		if (!empty($source)) {
+			$this->load($source, $parentTemplate);
+		}
+	}
+
+	/**
+	 *  Load template data from a string or file
+	 *  @name   load
+	 *  @type   method
+	 *  @access public
+	 *  @param  string source
+	 *  @param  CoreTemplateToken parentTemplate
+	 *  @return CoreTemplateToken
+	 *  @note   The token tree is cached (see CoreTemplateCache) for as long as neither the template nor any of its
+	 *          includes is modified
+	 */
+	public function load(string $source, ?CoreTemplateToken $parentTemplate=null):CoreTemplateToken {
+		$file  = $this->_getFileName($source);
+		$cache = $this->call('../Cache/key', __CLASS__, $file ?: $source);
+		$entry = $this->call('../Cache/fetch', $cache);
+
+		if (!is_array($entry) || !$this->_isFresh($entry['dependency'])) {
+			$entry = $this->compile($file ? file_get_contents($file) : $source, $file);
+			$this->call('../Cache/store', $cache, $entry);
+		}
+
+		$this->_tree           = $entry['tree'];
+		$this->_dependency     = $entry['dependency'];
+		$this->_unsupported    = $entry['unsupported'];
+		$this->_parentTemplate = $parentTemplate;
+		$this->origin          = $file ? '(file) ' . $file : '(string) ' . substr($source, 0, 150);
+
+		return $this;
+	}
+
+	/**
+	 *  Compile template source into its token tree
+	 *  @name   compile
+	 *  @type   method
+	 *  @access public
+	 *  @param  string source
+	 *  @param  string file (optional, the file the source was read from)
+	 *  @return array  compiled template (tree, dependency and unsupported)
+	 */
+	public function compile(string $source, ?string $file=null):array {
+		$this->_dependency  = $file ? Array($file => filemtime($file)) : Array();
+		$this->_unsupported = Array();
+		$this->_sequence    = 0;
+
+		return Array(
+			'tree'        => $this->_parse(preg_replace('/<\?xml.*?\?>/s', '', $source)),
+			'dependency'  => $this->_dependency,
+			'unsupported' => array_values(array_unique($this->_unsupported))
+		);
+	}
+
+	/**
+	 *  Determine whether all features used in the template are supported by this engine
+	 *  @name   isSupported
+	 *  @type   method
+	 *  @access public
+	 *  @return bool supported
+	 */
+	public function isSupported():bool {
+		return count($this->_unsupported) === 0;
+	}
+
+	/**
+	 *  Obtain the list of files the template depends on (the template file itself and all of its includes)
+	 *  @name   getDependencies
+	 *  @type   method
+	 *  @access public
+	 *  @return array file modification time by file name
+	 */
+	public function getDependencies():array<string, int> {
+		return $this->_dependency;
+	}
+
+	/**
+	 *  Obtain the list of paths where templates are (configured to be) found
+	 *  @name   getPathList
+	 *  @type   method
+	 *  @access public
+	 *  @return array path
+	 */
+	public function getPathList():array<string> {
+		return $this->_templatePath;
+	}
+
+	/**
+	 *  Duplicate the contents of a block (<k:block name="xx">)
+	 *  @name   block
+	 *  @type   method
+	 *  @access public
+	 *  @param  string name
+	 *  @return mixed CoreTemplateToken or CoreTemplateGroup
+	 */
+	public function block(string $name):mixed {
+		$group = Vector {};
+		foreach ($this->_tree as $node) {
+			if ($node[0] === self::TOKEN_BLOCK && $node[2] === $name) {
+				if (!$this->_stack->contains($node[1])) {
+					$this->_stack->set($node[1], Vector<CoreTemplateToken> {});
+				}
+
+				$index    = count($this->_stack->get($node[1]));
+				$template = $this->instance('../Token');
+				$template->_adopt($node[3], $this);
+				$template->_position = $index;
+				$template->_parity   = $index % 2 == 0 ? 'even' : 'odd';
+				$template->_name     = $name;
+
+				$this->_stack->get($node[1])->add($template);
+				$group[] = $template;
+			}
+		}
+
+		if (count($group) == 1) {
+			return $group[0];
+		}
+		else if (count($group) > 1) {
+			return $this->instance('../Group', $group);
+		}
+
+		return false;
+	}
+
+	/**
+	 *  Populate a block (<k:block name="xx">) with a row for every item, each item provides the block variables
+	 *  @name   bind
+	 *  @type   method
+	 *  @access public
+	 *  @param  string      name
+	 *  @param  Traversable items (e.g. CoreDBMySQLi::stream)
+	 *  @return int number of items
+	 */
+	public function bind(string $name, Traversable<mixed> $items):int {
+		$count = 0;
+
+		foreach ($items as $item) {
+			$block = $this->block($name);
+			if (!$block) {
+				break;
+			}
+
+			foreach ($item as $key=>$value) {
+				$block->{$key} = $value;
+			}
+			++$count;
+		}
+
+		return $count;
+	}
+
+	/**
+	 *  Render the template
+	 *  @name   render
+	 *  @type   method
+	 *  @access public
+	 *  @param  bool replace (default true)
+	 *  @param  bool asDOM (default false)
+	 *  @return mixed string HTML or DOMDocument
+	 */
+	public function render(bool $replace=true, bool $asDOM=false):mixed {
+		$requires = Vector<array<string, string>> {};
+		$result   = $this->_resolveRequirements($this->compose($requires, $replace), $requires);
+
+		if (count($this->_filters)) {
+			$result = $this->_applyFilters($result);
+		}
+
+		return $asDOM ? $this->_createDOM($result) : trim($result);
+	}
+
+	/**
+	 *  Render the template without resolving the requirements, as these are resolved by the outermost template
+	 *  @name   compose
+	 *  @type   method
+	 *  @access public
+	 *  @param  Vector requirements (collects the requirements of this template and its children)
+	 *  @param  bool replace (default true)
+	 *  @return string HTML
+	 */
+	public function compose(Vector<array<string, string>> $requires, bool $replace=true):string {
+		return $this->_compose($this->_tree, $requires, $replace);
+	}
+
+	/**
+	 *  Use (a subtree of) another template as the token tree of this template
+	 *  @name   _adopt
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array tree
+	 *  @param  CoreTemplateToken parentTemplate
+	 *  @return void
+	 */
+	protected function _adopt(array $tree, CoreTemplateToken $parentTemplate):void {
+		$this->_tree           = $tree;
+		$this->_templatePath   = $parentTemplate->getPathList();
+		$this->_parentTemplate = $parentTemplate;
+		$this->_filters        = Array();
+		$this->origin          = $parentTemplate->origin;
+	}
+
+	/**
+	 *  Parse the source into a token tree
+	 *  @name   _parse
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string source
+	 *  @param  int    include depth
+	 *  @return array  tree
+	 */
+	protected function _parse(string $source, int $depth=0):array {
+		if ($depth > self::MAX_DEPTH) {
+			$this->exception('Maximum include depth of ' . self::MAX_DEPTH . ' exceeded');
+		}
+
+		//  1: raw content (scripts and comments), 2-5: feature element (closing, name, attributes, self-closing)
+		//  6-8: attribute consisting of only a placeholder (name, key, default), 9-10: placeholder (key, default)
+		$pattern = '/(<script\b[^>]*>.*?<\/script>|<!--.*?-->)' .
+			'|<(\/?)k:([a-zA-Z]+)((?:\s+[a-zA-Z_:][\w:\.-]*\s*=\s*(?:"[^"]*"|\'[^\']*\'))*)\s*(\/?)>' .
+			'|\s+([a-zA-Z_:][\w:\.-]*)="\{([a-zA-Z0-9_-]+)(?::([^}"]*))?\}"' .
+			'|\{([a-zA-Z0-9_-]+)(?::([^}]*))?\}/s';
+
+		$level  = Array(Array());
+		$open   = Array();
+		$offset = 0;
+
+		$this->_detectUnsupported($source);
+		preg_match_all($pattern, $source, $match, PREG_SET_ORDER | PREG_OFFSET_CAPTURE);
+
+		foreach ($match as $m) {
+			list($token, $position) = $m[0];
+			if ($position > $offset) {
+				$level[count($level) - 1][] = Array(self::TOKEN_TEXT, substr($source, $offset, $position - $offset));
+			}
+			$offset = $position + strlen($token);
+
+			if (isset($m[1]) && $m[1][1] >= 0) {
+				$level[count($level) - 1][] = Array(self::TOKEN_TEXT, $token);
+			}
+			else if (isset($m[3]) && $m[3][1] >= 0) {
+				$name    = strtolower($m[3][0]);
+				$closing = $m[2][0] === '/';
+				$empty   = $m[5][0] === '/';
+
+				if ($closing) {
+					$node     = array_pop($open);
+					$children = array_pop($level);
+
+					if (!is_array($node) || $node['name'] !== $name) {
+						$this->exception('Unexpected closing </k:' . $name . '> in template');
+					}
+
+					switch ($name) {
+						case 'block':
+							$node['token'][3] = $children;
+							$level[count($level) - 1][] = $node['token'];
+							break;
+
+						case 'require':
+							$node['token'][1]['content'] = $this->_stripCDATA(substr($source, $node['offset'], $position - $node['offset']));
+							$level[count($level) - 1][] = $this->_requirement($node['token']);
+							break;
+
+						default:
+							//  the content of any other feature is discarded
+							if ($node['token']) {
+								$level[count($level) - 1][] = $node['token'];
+							}
+							break;
+					}
+
+					continue;
+				}
+
+				$attribute = $this->_parseAttributes($m[4][0]);
+				$token     = null;
+				switch ($name) {
+					case 'block':
+						$token = Array(self::TOKEN_BLOCK, ++$this->_sequence, isset($attribute['name']) ? $attribute['name'] : '', Array());
+						break;
+
+					case 'require':
+						$attribute['content'] = '';
+						$token = Array(self::TOKEN_REQUIRE, $attribute);
+						break;
+
+					case 'include':
+						$file = isset($attribute['file']) ? $this->_getFileName($attribute['file']) : null;
+						if ($file) {
+							$this->_dependency[$file] = filemtime($file);
+							foreach ($this->_parse(file_get_contents($file), $depth + 1) as $child) {
+								$level[count($level) - 1][] = $child;
+							}
+						}
+						else {
+							$this->call('/Log/message', 'Template include not found: "' . (isset($attribute['file']) ? $attribute['file'] : '') . '"', 2);
+						}
+						break;
+
+					case 'script':
+						$token = Array(self::TOKEN_SCRIPT);
+						break;
+
+					case 'style':
+						$token = Array(self::TOKEN_STYLE);
+						break;
+
+					default:
+						//  leave unsupported features untouched (the template will have been marked as unsupported)
+						$level[count($level) - 1][] = Array(self::TOKEN_TEXT, $m[0][0]);
+						continue 2;
+				}
+
+				if (!$empty) {
+					//  open a container, anything but blocks and requirements discards its content
+					$open[]  = Array('name' => $name, 'token' => $token, 'offset' => $offset);
+					$level[] = Array();
+				}
+				else if ($token) {
+					$level[count($level) - 1][] = $name === 'require' ? $this->_requirement($token) : $token;
+				}
+			}
+			else if (isset($m[6]) && $m[6][1] >= 0) {
+				$level[count($level) - 1][] = Array(self::TOKEN_ATTRIBUTE, $m[6][0], $m[7][0], isset($m[8]) && $m[8][1] >= 0 ? $m[8][0] : '');
+			}
+			else {
+				$level[count($level) - 1][] = Array(self::TOKEN_PLACEHOLDER, $m[9][0], isset($m[10]) && $m[10][1] >= 0 ? $m[10][0] : '');
+			}
+		}
+
+		if (count($open)) {
+			$this->exception('Unclosed <k:' . $open[count($open) - 1]['name'] . '> in template');
+		}
+
+		if ($offset < strlen($source)) {
+			$level[0][] = Array(self::TOKEN_TEXT, substr($source, $offset));
+		}
+
+		return $this->_mergeText($level[0]);
+	}
+
+	/**
+	 *  Merge adjacent text tokens, keeping the tree as small as possible
+	 *  @name   _mergeText
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array tree
+	 *  @return array tree
+	 */
+	protected function _mergeText(array $tree):array {
+		$result = Array();
+		$last   = -1;
+		foreach ($tree as $node) {
+			if ($node[0] === self::TOKEN_TEXT && $last >= 0 && $result[$last][0] === self::TOKEN_TEXT) {
+				$result[$last][1] .= $node[1];
+				continue;
+			}
+
+			if ($node[0] === self::TOKEN_BLOCK) {
+				$node[3] = $this->_mergeText($node[3]);
+			}
+
+			$result[] = $node;
+			$last     = count($result) - 1;
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Register all features used in the source which are not supported by this engine
+	 *  @name   _detectUnsupported
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string source
+	 *  @return void
+	 */
+	protected function _detectUnsupported(string $source):void {
+		$supported = Array('block', 'include', 'require', 'script', 'style');
+		$namespace = Array('k');
+		foreach ($this->getRoot()->getFilePath() as $tier=>$path) {
+			$namespace[] = strtolower($tier);
+		}
+
+		if (preg_match_all('/<\/?([a-zA-Z]+):([a-zA-Z]+)|\s([a-zA-Z]+):([a-zA-Z]+)\s*=/', $source, $match, PREG_SET_ORDER)) {
+			foreach ($match as $m) {
+				if (!empty($m[1]) && in_array(strtolower($m[1]), $namespace)) {
+					if (strtolower($m[1]) !== 'k' || !in_array(strtolower($m[2]), $supported)) {
+						$this->_unsupported[] = $m[1] . ':' . $m[2];
+					}
+				}
+				else if (!empty($m[3]) && in_array(strtolower($m[3]), $namespace)) {
+					$this->_unsupported[] = '@' . $m[3] . ':' . $m[4];
+				}
+			}
+		}
+	}
+
+	/**
+	 *  Parse an attribute string into a key/value array
+	 *  @name   _parseAttributes
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string attributes
+	 *  @return array  attributes
+	 */
+	protected function _parseAttributes(string $input):array<string, string> {
+		$result = Array();
+		if (preg_match_all('/([a-zA-Z_:][\w:\.-]*)\s*=\s*(?:"([^"]*)"|\'([^\']*)\')/', $input, $match, PREG_SET_ORDER)) {
+			foreach ($match as $m) {
+				$result[$m[1]] = html_entity_decode(isset($m[3]) ? $m[3] : $m[2], ENT_QUOTES, 'UTF-8');
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Complete a requirement token (determine its type and inline script hash)
+	 *  @name   _requirement
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array token
+	 *  @return array token
+	 */
+	protected function _requirement(array $token):array {
+		$attribute = $token[1];
+		if (!empty($attribute['file']) && empty($attribute['type'])) {
+			switch (pathinfo($attribute['file'], PATHINFO_EXTENSION)) {
+				case 'js':
+					$attribute['type'] = 'text/javascript';
+					break;
+
+				case 'css':
+					$attribute['type'] = 'text/css';
+					break;
+			}
+		}
+
+		if (empty($attribute['file']) && !empty($attribute['content']) && isset($attribute['type']) && $attribute['type'] === 'text/javascript') {
+			$attribute['hash'] = 'sha256-' . base64_encode(hash('sha256', $attribute['content'], true));
+		}
+
+		$token[1] = $attribute;
+
+		return $token;
+	}
+
+	/**
+	 *  Remove CDATA wrapping from inline requirement content
+	 *  @name   _stripCDATA
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string content
+	 *  @return string content
+	 */
+	protected function _stripCDATA(string $content):string {
+		return trim(preg_replace('/<!\[CDATA\[(.*?)\]\]>/s', '\\1', $content));
+	}
+
+	/**
+	 *  Compose a (sub)tree into HTML
+	 *  @name   _compose
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array  tree
+	 *  @param  Vector requirements
+	 *  @param  bool   replace
+	 *  @return string HTML
+	 */
+	protected function _compose(array $tree, Vector<array<string, string>> $requires, bool $replace):string {
+		$result = '';
+		foreach ($tree as $node) {
+			switch ($node[0]) {
+				case self::TOKEN_TEXT:
+					$result .= $node[1];
+					break;
+
+				case self::TOKEN_PLACEHOLDER:
+					$result .= $replace ? $this->_placeholderValue($node[1], $node[2], $requires) : '{' . $node[1] . ($node[2] !== '' ? ':' . $node[2] : '') . '}';
+					break;
+
+				case self::TOKEN_ATTRIBUTE:
+					$value = $replace ? $this->_placeholderValue($node[2], $node[3], $requires) : '{' . $node[2] . ($node[3] !== '' ? ':' . $node[3] : '') . '}';
+					//  if the placeholder value is empty, remove the entire attribute
+					if (!preg_match('/^\s*$/', $value)) {
+						$result .= ' ' . $node[1] . '="' . $value . '"';
+					}
+					break;
+
+				case self::TOKEN_BLOCK:
+					if ($this->_stack->contains($node[1])) {
+						foreach ($this->_stack->get($node[1]) as $template) {
+							$result .= $template->compose($requires, $replace);
+						}
+					}
+					break;
+
+				case self::TOKEN_REQUIRE:
+					$requires[] = $node[1];
+					//  fixated requirements are placed at their own position
+					if (isset($node[1]['fixate']) && $node[1]['fixate'] === 'true') {
+						$result .= self::MARKER . 'require:' . (count($requires) - 1) . self::MARKER;
+					}
+					break;
+
+				case self::TOKEN_SCRIPT:
+					$result .= self::MARKER . 'script' . self::MARKER;
+					break;
+
+				case self::TOKEN_STYLE:
+					$result .= self::MARKER . 'style' . self::MARKER;
+					break;
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Obtain the proper (HTML) value for given placeholder
+	 *  @name   _placeholderValue
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string key
+	 *  @param  string default
+	 *  @param  Vector requirements
+	 *  @return string HTML
+	 */
+	protected function _placeholderValue(string $key, string $default, Vector<array<string, string>> $requires):string {
+		if (!isset($this->_property[$key])) {
+			return $default;
+		}
+
+		$value = $this->_property[$key];
+		if (is_scalar($value)) {
+			return htmlspecialchars((string) $value, ENT_COMPAT, 'UTF-8');
+		}
+		else if ($value instanceof CoreTemplateToken) {
+			return $value->compose($requires);
+		}
+		else if ($value instanceof CoreTemplate) {
+			return $value->render();
+		}
+		else if ($value instanceof DOMText) {
+			return htmlspecialchars($value->nodeValue, ENT_COMPAT, 'UTF-8');
+		}
+		else if ($value instanceof DOMDocument) {
+			return $value->saveHTML($value->documentElement);
+		}
+		else if ($value instanceof DOMNode) {
+			return $value->ownerDocument->saveHTML($value);
+		}
+
+		$this->call('/Log/message', 'Cannot handle ' . (is_object($value) ? get_class($value) : gettype($value)) . ' placeholder values', 2);
+
+		return '';
+	}
+
+	/**
+	 *  Replace the script, style and fixated requirement markers with the collected requirements
+	 *  @name   _resolveRequirements
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string HTML
+	 *  @param  Vector requirements
+	 *  @return string HTML
+	 */
+	protected function _resolveRequirements(string $html, Vector<array<string, string>> $requires):string {
+		$collect = Map<string, string> {'script' => '', 'style' => ''};
+		$files   = Map<string, bool> {};
+		$replace = Array();
+
+		foreach ($requires as $index=>$requirement) {
+			$type = isset($requirement['type']) ? $requirement['type'] : null;
+			$file = isset($requirement['file']) ? $requirement['file'] : null;
+
+			//  requirements referencing an external file will be included only once unless the multiple="true" attribute is set
+			if ($file) {
+				if ($files->contains($type . $file) && (!isset($requirement['multiple']) || $requirement['multiple'] !== 'true')) {
+					continue;
+				}
+				$files->set($type . $file, true);
+			}
+
+			switch ($type) {
+				case 'text/javascript':
+					$element = $file
+						? '<script type="text/javascript" src="' . htmlspecialchars($file, ENT_COMPAT, 'UTF-8') . '"></script>'
+						: '<script type="text/javascript">' . $requirement['content'] . '</script>';
+					$target = 'script';
+					break;
+
+				case 'text/css':
+					$element = $file
+						? '<link rel="stylesheet" type="text/css" href="' . htmlspecialchars($file, ENT_COMPAT, 'UTF-8') . '"/>'
+						: '<style type="text/css">' . $requirement['content'] . '</style>';
+					$target = 'style';
+					break;
+
+				default:
+					continue 2;
+			}
+
+			if (!$file && empty($requirement['content'])) {
+				continue;
+			}
+
+			if (isset($requirement['fixate']) && $requirement['fixate'] === 'true') {
+				$replace[self::MARKER . 'require:' . $index . self::MARKER] = $element;
+			}
+			else {
+				$collect->set($target, $collect->get($target) . $element);
+			}
+		}
+
+		$replace[self::MARKER . 'script' . self::MARKER] = $collect->get('script');
+		$replace[self::MARKER . 'style' . self::MARKER]  = $collect->get('style');
+
+		$result = strtr($html, $replace);
+
+		//  remove any marker left (fixated requirements which were skipped as duplicate)
+		return strpos($result, self::MARKER) !== false ? preg_replace('/' . self::MARKER . '[^' . self::MARKER . ']*' . self::MARKER . '/', '', $result) : $result;
+	}
+
+	/**
+	 *  Apply the configured filters (the string equivalents of CoreTemplateFilter)
+	 *  @name   _applyFilters
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string HTML
+	 *  @return string HTML
+	 */
+	protected function _applyFilters(string $html):string {
+		foreach ($this->_filters as $filter) {
+			switch (strtolower($filter)) {
+				case 'comment':
+					//  leave IE's conditional comments alone
+					$html = preg_replace('/<!--(?!\[if).*?-->/s', '', $html);
+					break;
+
+				case 'whitespace':
+					//  compress whitespace not in <pre>, <code>, <script> or <textarea> tags
+					$part = preg_split('/(<(pre|code|script|textarea)\b.*?<\/\2>)/si', $html, -1, PREG_SPLIT_DELIM_CAPTURE);
+					$html = '';
+					for ($i = 0; $i < count($part); ++$i) {
+						if ($i % 3 === 0) {
+							$html .= preg_replace('/\s+/', ' ', $part[$i]);
+						}
+						else if ($i % 3 === 1) {
+							$html .= $part[$i];
+						}
+					}
+					break;
+
+				default:
+					$this->call('/Log/message', 'Template filter "' . $filter . '" is not supported by ' . __CLASS__, 3);
+					break;
+			}
+		}
+
+		return $html;
+	}
+
+	/**
+	 *  Create a DOMDocument from the rendered HTML, unwrapped the same way CoreTemplate does
+	 *  @name   _createDOM
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string HTML
+	 *  @return DOMDocument
+	 */
+	protected function _createDOM(string $html):DOMDocument {
+		$resolver = $this->get('/Config/Template/entityresolver', 'Entity/utf8');
+		if ($resolver && preg_match_all('/&([a-zA-Z]+);/U', $html, $match)) {
+			foreach (array_unique($match[1]) as $entity) {
+				if (!in_array($entity, Array('amp', 'lt', 'gt', 'quot', 'apos'))) {
+					$html = str_replace('&' . $entity . ';', $this->call('../' . $resolver, $entity), $html);
+				}
+			}
+		}
+
+		$dom = new DOMDocument();
+		$dom->loadXML('<' . __CLASS__ . '>' . $html . '</' . __CLASS__ . '>');
+
+		if ($dom->documentElement) {
+			while ($dom->documentElement->firstChild) {
+				$dom->appendChild($dom->documentElement->removeChild($dom->documentElement->firstChild));
+			}
+			$dom->removeChild($dom->documentElement);
+		}
+
+		return $dom;
+	}
+
+	/**
+	 *  Verify none of the dependencies was modified since the template was compiled
+	 *  @name   _isFresh
+	 *  @type   method
+	 *  @access protected
+	 *  @param  array  file modification time by file name
+	 *  @return bool   fresh
+	 */
+	protected function _isFresh(array<string, int> $dependency):bool {
+		foreach ($dependency as $file=>$time) {
+			if (!is_file($file) || filemtime($file) !== $time) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 *  Try to determine if given source may be a file and if so, see whether it exists
+	 *  @name   _getFileName
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string source
+	 *  @return string filename (null if no filename could be determined)
+	 */
+	protected function _getFileName(string $source):?string {
+		$result = null;
+		if (preg_match('/^[a-zA-Z0-9_\.\/-]+\.[a-zA-Z]+ml$/', $source)) {
+			if (realpath($source)) {
+				$result = realpath($source);
+				if (!in_array(dirname($result), $this->_templatePath)) {
+					array_unshift($this->_templatePath, dirname($result));
+				}
+			}
+			else {
+				foreach ($this->_templatePath as $path) {
+					$file = realpath($path . '/' . $source);
+					if ($file) {
+						$result = $file;
+						break;
+					}
+				}
+			}
+		}
+
+		return $result;
+	}
+}
@@ -0,0 +1,325 @@
+<?hh  //  strict
+
+
+/**
+ *  Template warmup, walking the template path to build the include/require dependency graph, validating every
+ *  template and precompiling the templates of the token engine into the template cache (CoreTemplateCache)
+ *  @name    CoreTemplateWarmup
+ *  @package Konsolidate
+ *  @author  Rogier Spieker <rogier@konsolidate.nl>
+ *  @note    For the compiled templates to be available to other processes (e.g. when run from the command line at
+ *           deploy time), /Config/Template/cachepath must be configured identically for both. The DOM engine cannot
+ *           be precompiled, as its DOMDocument and the features bound to its nodes cannot be stored, its templates
+ *           are loaded to report errors and timing only
+ */
+class CoreTemplateWarmup<Konsolidate> extends Konsolidate {
+	/**
+	 *  The dependency graph (and compile statistics) by template file
+	 *  @name    _graph
+	 *  @type    Map
+	 *  @access  protected
+	 */
+	protected Map<string, Map<string, mixed>> $_graph;
+
+
+	/**
+	 *  Constructor
+	 *  @name   __construct
+	 *  @type   method
+	 *  @access public
+	 *  @param  Konsolidate $parent
+	 *  @return CoreTemplateWarmup
+	 */
+	public function __construct(Konsolidate $parent) {
+		parent::__construct($parent);
+
+		$this->_graph = Map<string, Map<string, mixed>> {};
+	}
+
+	/**
+	 *  Build the dependency graph, validate all templates and precompile them for the token engine
+	 *  @name   run
+	 *  @type   method
+	 *  @access public
+	 *  @param  string root (optional, default the configured /Config/Template/path)
+	 *  @param  string engine (optional, default the configured /Config/Template/engine, 'auto' loads with both)
+	 *  @return Map    dependency graph
+	 *  @note   Expired entries are removed from the template cache afterwards (see CoreTemplateCache::prune)
+	 */
+	public function run(?string $root=null, ?string $engine=null):Map<string, Map<string, mixed>> {
+		$root   = realpath($root ?: $this->get('/Config/Template/path'));
+		$engine = strtolower($engine ?: $this->get('/Config/Template/engine', 'dom'));
+
+		if (!$root || !is_dir($root)) {
+			$this->exception('Template path "' . $root . '" is not a directory');
+		}
+
+		$this->_graph = Map<string, Map<string, mixed>> {};
+		foreach ($this->_findTemplates($root) as $file) {
+			$this->_graph->set($file, $this->_analyze($file, $root));
+		}
+
+		foreach ($this->_graph as $file=>$node) {
+			$node->set('total', $this->_totalSize($file, Map<string, bool> {}));
+			$node->set('cycle', $this->_hasCycle($file, Vector<string> {}));
+
+			//  a template including itself (indirectly) cannot be compiled
+			if (!$node->get('cycle')) {
+				$this->_compile($file, $node, $engine);
+			}
+		}
+		$this->call('../Cache/prune');
+
+		return $this->_graph;
+	}
+
+	/**
+	 *  Create a report of the dependency graph, flagging slow, oversized and broken templates
+	 *  @name   report
+	 *  @type   method
+	 *  @access public
+	 *  @param  float  slow threshold in milliseconds (optional, default /Config/Template/warmupslow or 50)
+	 *  @param  int    size threshold in bytes, including includes (optional, default /Config/Template/warmupsize or 256KiB)
+	 *  @param  bool   include the full graph (optional, default false)
+	 *  @return string report
+	 */
+	public function report(?float $slow=null, ?int $size=null, bool $graph=false):string {
+		$slow   = $slow ?: (float) $this->get('/Config/Template/warmupslow', 50);
+		$size   = $size ?: (int) $this->get('/Config/Template/warmupsize', 262144);
+		$report = Array();
+		$issue  = Array();
+
+		foreach ($this->_graph as $file=>$node) {
+			if ($graph) {
+				$report[] = sprintf('%s (%d bytes, %d with includes, %.1f ms)', $file, $node->get('size'), $node->get('total'), $node->get('time'));
+				foreach (Array('include', 'require', 'block') as $type) {
+					foreach ($node->get($type) as $dependency) {
+						$report[] = '  ' . $type . ' ' . $dependency;
+					}
+				}
+			}
+
+			if ($node->get('cycle')) {
+				$issue[] = 'CYCLE     ' . $file;
+			}
+			if ($node->get('error')) {
+				$issue[] = 'ERROR     ' . $file . ': ' . $node->get('error');
+			}
+			if ($node->get('time') > $slow) {
+				$issue[] = sprintf('SLOW      %s (%.1f ms)', $file, $node->get('time'));
+			}
+			if ($node->get('total') > $size) {
+				$issue[] = sprintf('OVERSIZED %s (%d bytes with includes)', $file, $node->get('total'));
+			}
+			foreach ($node->get('missing') as $missing) {
+				$issue[] = 'MISSING   ' . $file . ' includes ' . $missing;
+			}
+		}
+
+		$report[] = sprintf('%d templates processed, %d issues', count($this->_graph), count($issue));
+
+		return implode(PHP_EOL, array_merge($report, $issue)) . PHP_EOL;
+	}
+
+	/**
+	 *  Determine whether any of the compiled templates has an issue (other than being slow or oversized)
+	 *  @name   hasErrors
+	 *  @type   method
+	 *  @access public
+	 *  @return bool errors
+	 */
+	public function hasErrors():bool {
+		foreach ($this->_graph as $node) {
+			if ($node->get('cycle') || $node->get('error') || count($node->get('missing'))) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 *  Find all template files in the given directory (and its subdirectories)
+	 *  @name   _findTemplates
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string directory
+	 *  @return Vector files
+	 */
+	protected function _findTemplates(string $root):Vector<string> {
+		$result   = Vector<string> {};
+		$iterator = new RecursiveIteratorIterator(new RecursiveDirectoryIterator($root, FilesystemIterator::SKIP_DOTS));
+
+		foreach ($iterator as $item) {
+			//  the same pattern CoreTemplate uses to recognize template files
+			if ($item->isFile() && preg_match('/\.[a-zA-Z]+ml$/', $item->getFilename())) {
+				$result[] = $item->getRealPath();
+			}
+		}
+
+		return $result;
+	}
+
+	/**
+	 *  Extract the includes, requires and blocks from the template source
+	 *  @name   _analyze
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string file
+	 *  @param  string root
+	 *  @return Map    node
+	 */
+	protected function _analyze(string $file, string $root):Map<string, mixed> {
+		$source = file_get_contents($file);
+		$node   = Map<string, mixed> {
+			'size'    => strlen($source),
+			'include' => Vector<string> {},
+			'missing' => Vector<string> {},
+			'require' => Vector<string> {},
+			'block'   => Vector<string> {},
+			'time'    => 0.0,
+			'error'   => null
+		};
+
+		if (preg_match_all('/<k:(include|require|block)\b[^>]*?\b(file|name)\s*=\s*(?:"([^"]*)"|\'([^\']*)\')/', $source, $match, PREG_SET_ORDER)) {
+			foreach ($match as $m) {
+				$value = isset($m[4]) && $m[4] !== '' ? $m[4] : $m[3];
+				switch ($m[1] . ':' . $m[2]) {
+					case 'include:file':
+						$include = $this->_resolve($value, Array(dirname($file), $root));
+						if ($include) {
+							$node->get('include')->add($include);
+						}
+						else {
+							$node->get('missing')->add($value);
+						}
+						break;
+
+					case 'require:file':
+						$node->get('require')->add($value);
+						break;
+
+					case 'block:name':
+						$node->get('block')->add($value);
+						break;
+				}
+			}
+		}
+
+		return $node;
+	}
+
+	/**
+	 *  Resolve an include the same way CoreTemplate does
+	 *  @name   _resolve
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string file
+	 *  @param  array  path list
+	 *  @return string file (null if not found)
+	 */
+	protected function _resolve(string $file, array<string> $pathList):?string {
+		if (realpath($file)) {
+			return realpath($file);
+		}
+
+		foreach ($pathList as $path) {
+			if (realpath($path . '/' . $file)) {
+				return realpath($path . '/' . $file);
+			}
+		}
+
+		return null;
+	}
+
+	/**
+	 *  Calculate the size of the template including all of its (nested) includes
+	 *  @name   _totalSize
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string file
+	 *  @param  Map    visited files
+	 *  @return int    size
+	 */
+	protected function _totalSize(string $file, Map<string, bool> $visited):int {
+		if ($visited->contains($file)) {
+			return 0;
+		}
+		$visited->set($file, true);
+
+		if (!$this->_graph->contains($file)) {
+			return is_file($file) ? filesize($file) : 0;
+		}
+
+		$size = $this->_graph->get($file)->get('size');
+		foreach ($this->_graph->get($file)->get('include') as $include) {
+			//  every include is inserted where it is referenced
+			$size += $this->_totalSize($include, $visited);
+		}
+
+		return $size;
+	}
+
+	/**
+	 *  Determine whether the template includes itself (directly or indirectly)
+	 *  @name   _hasCycle
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string file
+	 *  @param  Vector include path
+	 *  @return bool   cycle
+	 */
+	protected function _hasCycle(string $file, Vector<string> $path):bool {
+		if ($path->linearSearch($file) >= 0) {
+			return true;
+		}
+
+		if ($this->_graph->contains($file)) {
+			$path->add($file);
+			foreach ($this->_graph->get($file)->get('include') as $include) {
+				if ($this->_hasCycle($include, $path)) {
+					return true;
+				}
+			}
+			$path->pop();
+		}
+
+		return false;
+	}
+
+	/**
+	 *  Load the template (and thereby its includes), compiling it into the cache for the token engine
+	 *  @name   _compile
+	 *  @type   method
+	 *  @access protected
+	 *  @param  string file
+	 *  @param  Map    node
+	 *  @param  string engine
+	 *  @return void
+	 */
+	protected function _compile(string $file, Map<string, mixed> $node, string $engine):void {
+		$internal = libxml_use_internal_errors(true);
+		$start    = microtime(true);
+
+		try {
+			if ($engine === 'dom' || $engine === 'auto') {
+				$this->instance('/Template', $file);
+			}
+			if ($engine === 'token' || $engine === 'auto') {
+				$this->call('/Template/Engine/create', $file, 'token');
+			}
+
+			$error = libxml_get_errors();
+			if (count($error)) {
+				$node->set('error', trim($error[0]->message) . ' (line ' . $error[0]->line . ')');
+			}
+		}
+		catch (Exception $exception) {
+			$node->set('error', $exception->getMessage());
+		}
+
+		$node->set('time', (microtime(true) - $start) * 1000);
+		libxml_clear_errors();
+		libxml_use_internal_errors($internal);
+	}
+}